@@ -0,0 +1,16 @@
+# Headless simulation core (no raylib), for build boxes / validation runs
+mkdir -p build
+SIM_SOURCES="sim sim_simd thread sim_thread solver graph preview hint replay rewind"
+for f in $SIM_SOURCES; do cc -c src/$f.c -o build/$f.o -Wall -std=c99 -D_DEFAULT_SOURCE -O2 -Isrc || exit 1; done
+ar rcs build/libsim.a $(for f in $SIM_SOURCES; do echo build/$f.o; done)
+cc -o build/bench src/bench.c build/libsim.a -Wall -std=c99 -D_DEFAULT_SOURCE -O2 -Isrc -lm -lpthread || exit 1
+cc -o build/par_check src/par_check.c build/libsim.a -Wall -std=c99 -D_DEFAULT_SOURCE -O2 -Isrc -lm -lpthread || exit 1
+cc -o build/levelgen src/levelgen.c build/libsim.a -Wall -std=c99 -D_DEFAULT_SOURCE -O2 -Isrc -lm -lpthread || exit 1
+cc -o build/verify src/verify.c build/libsim.a -Wall -std=c99 -D_DEFAULT_SOURCE -O2 -Isrc -lm -lpthread || exit 1
+cc -o build/playback src/playback.c build/libsim.a -Wall -std=c99 -D_DEFAULT_SOURCE -O2 -Isrc -lm -lpthread || exit 1
+cc -o build/validate src/validate.c build/libsim.a -Wall -std=c99 -D_DEFAULT_SOURCE -O2 -Isrc -lm -lpthread || exit 1
+cc -o build/desync src/desync.c build/libsim.a -Wall -std=c99 -D_DEFAULT_SOURCE -O2 -Isrc -lm -lpthread || exit 1
+# fails the build if a par in src/levels.h does not match the solver
+./build/par_check || exit 1
+# fails the build if a known solution stops working
+./build/verify solutions.txt || exit 1
@@ -41,7 +41,9 @@ set OUT_EXE=scaletd.exe
 set OUT_DIR=build
 set INCLUDES=/I include /I src
 set SOURCES=src\main.c
-set LIBS=lib\raylib.lib
+set SIM_SOURCES=src\sim.c src\sim_simd.c src\thread.c src\sim_thread.c src\solver.c src\graph.c src\preview.c src\hint.c src\replay.c src\rewind.c
+set SIM_LIB=%OUT_DIR%\sim.lib
+set LIBS=lib\raylib.lib %SIM_LIB%
 set COMMON=/nologo /utf-8
 if "%debug%"=="1" (
 	set DEFINES=/D UNICODE /D _UNICODE /D _DEBUG
@@ -57,6 +59,21 @@ if "%INPUT%"=="clean" (exit /b)
 if not exist %OUT_DIR% mkdir %OUT_DIR%
 
 @echo on
+:: headless simulation core as static library (no raylib dependency)
+cl %COMMON% %OPTIONS% %INCLUDES% %DEFINES% /c %SIM_SOURCES% /Fo%OUT_DIR%/ || exit /B
+lib /nologo /OUT:%SIM_LIB% %OUT_DIR%\sim.obj %OUT_DIR%\sim_simd.obj %OUT_DIR%\thread.obj %OUT_DIR%\sim_thread.obj %OUT_DIR%\solver.obj %OUT_DIR%\graph.obj %OUT_DIR%\preview.obj %OUT_DIR%\hint.obj %OUT_DIR%\replay.obj %OUT_DIR%\rewind.obj || exit /B
+:: check the par of every level with the solver
+cl %COMMON% %OPTIONS% %INCLUDES% %DEFINES% src\par_check.c /Fe"%OUT_DIR%/par_check.exe" /Fo%OUT_DIR%/ /link %SIM_LIB% || exit /B
+"%OUT_DIR%\par_check.exe" || exit /B
+:: level generator, not run by the build
+cl %COMMON% %OPTIONS% %INCLUDES% %DEFINES% src\levelgen.c /Fe"%OUT_DIR%/levelgen.exe" /Fo%OUT_DIR%/ /link %SIM_LIB% || exit /B
+:: play the known solutions of every level
+cl %COMMON% %OPTIONS% %INCLUDES% %DEFINES% src\verify.c /Fe"%OUT_DIR%/verify.exe" /Fo%OUT_DIR%/ /link %SIM_LIB% || exit /B
+"%OUT_DIR%\verify.exe" solutions.txt || exit /B
+:: plays replays recorded by the game, not run by the build
+cl %COMMON% %OPTIONS% %INCLUDES% %DEFINES% src\playback.c /Fe"%OUT_DIR%/playback.exe" /Fo%OUT_DIR%/ /link %SIM_LIB% || exit /B
+cl %COMMON% %OPTIONS% %INCLUDES% %DEFINES% src\validate.c /Fe"%OUT_DIR%/validate.exe" /Fo%OUT_DIR%/ /link %SIM_LIB% || exit /B
+cl %COMMON% %OPTIONS% %INCLUDES% %DEFINES% src\desync.c /Fe"%OUT_DIR%/desync.exe" /Fo%OUT_DIR%/ /link %SIM_LIB% || exit /B
 cl %COMMON% %OPTIONS% %INCLUDES% %DEFINES% %SOURCES% /Fe"%OUT_DIR%/%OUT_EXE%" /Fo%OUT_DIR%/ /link %LIBS% || exit /B
 @echo off
 
@@ -1 +1,7 @@
-emcc -o build/mathtd.html src/main.c -Wall -std=c99 -D_DEFAULT_SOURCE -Wno-missing-braces -Wunused-result -Os -Isrc -Iinclude -I ../raylib/src -I ../raylib/src/external -L. -L ../raylib/src -s USE_GLFW=3 -s ASYNCIFY -s TOTAL_MEMORY=67108864 -s FORCE_FILESYSTEM=1 --shell-file shell.html ../raylib/src/libraylib.a -DPLATFORM_WEB -s 'EXPORTED_FUNCTIONS=["_free","_malloc","_main"]' -s EXPORTED_RUNTIME_METHODS=ccall
\ No newline at end of file
+mkdir -p build
+SIM_SOURCES="sim sim_simd thread sim_thread solver graph preview hint replay rewind"
+for f in $SIM_SOURCES; do emcc -c src/$f.c -o build/$f.o -Wall -std=c99 -D_DEFAULT_SOURCE -Os -Isrc -DPLATFORM_WEB || exit 1; done
+emar rcs build/libsim.a $(for f in $SIM_SOURCES; do echo build/$f.o; done)
+# desync tool for node (node build/desync.js ...), to compare the web simulation with the native one
+emcc -o build/desync.js src/desync.c build/libsim.a -Wall -std=c99 -D_DEFAULT_SOURCE -Os -Isrc -DPLATFORM_WEB -s NODERAWFS=1 || exit 1
+emcc -o build/mathtd.html src/main.c build/libsim.a -Wall -std=c99 -D_DEFAULT_SOURCE -Wno-missing-braces -Wunused-result -Os -Isrc -Iinclude -I ../raylib/src -I ../raylib/src/external -L. -L ../raylib/src -s USE_GLFW=3 -s ASYNCIFY -s TOTAL_MEMORY=67108864 -s FORCE_FILESYSTEM=1 --shell-file shell.html ../raylib/src/libraylib.a -DPLATFORM_WEB -s 'EXPORTED_FUNCTIONS=["_free","_malloc","_main"]' -s EXPORTED_RUNTIME_METHODS=ccall
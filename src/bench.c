@@ -0,0 +1,419 @@
+// Simulation throughput benchmark, no raylib needed.
+// Usage: bench [output file], results go to bench_output.txt by default.
+// One result per line as scenario,metric,value,unit so runs can be diffed and
+// tracked over time.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "sim.h"
+#include "sim_simd.h"
+#include "rewind.h"
+#include "thread.h"
+#include "levels.h"
+
+#define BENCH_MIN_SECONDS 0.25
+#define SCENARIO_FRAMES 20000
+
+typedef struct Bench
+{
+    FILE *out;
+} Bench;
+
+static void bench_report(Bench *b, const char *scenario, const char *metric, double value, const char *unit)
+{
+    fprintf(b->out, "%s,%s,%.6g,%s\n", scenario, metric, value, unit);
+    printf("%-24s %-28s %14.6g %s\n", scenario, metric, value, unit);
+}
+
+// Scenarios ------------------------------------------------------------------
+
+typedef void (*SetupFunc)(GameState *s, int arg);
+typedef void (*RefillFunc)(GameState *s, unsigned int frame);
+
+typedef struct Scenario
+{
+    char name[32];
+    SetupFunc setup;
+    RefillFunc refill; // keeps enemies coming, may be NULL
+    int arg;
+    bool cached; // runs with a HealthCache
+} Scenario;
+
+// towers next to the path (tile row 4), alternating above and below
+static void placeTowers(GameState *s, unsigned int allowed, int count, bool anyScale)
+{
+    int type = 0;
+    for (int i = 0; i < count && s->towerLen < MAX_TOWERS; ++i)
+    {
+        do
+        {
+            type = (type + 1) % ET_EOL;
+        } while (type == ET_NONE || (allowed & (1 << type)) == 0);
+
+        int tileX = 2 + (i / 4) % 14;
+        int tileY = (i % 4 < 2) ? 3 - i % 2 : 5 + i % 2;
+        state_addTower(s, tileX, tileY, type, anyScale ? 1 + i % 3 : defaultTowerScale(type));
+    }
+}
+
+static void setupLevel(GameState *s, int index)
+{
+    LevelDef l = LEVELS[index];
+    state_loadFromLevelDef(s, l, index);
+    placeTowers(s, l.towersAllowed, MIN(l.minSolution + 2, MAX_TOWERS), false);
+}
+
+static void setupMax(GameState *s, int arg)
+{
+    s->home.roundingFactor = 0;
+    placeTowers(s, 1 << ET_SUB, MAX_TOWERS, false);
+}
+
+// one enemy per frame that survives every tower, until MAX_ENEMIES are on the field
+static void refillMax(GameState *s, unsigned int frame)
+{
+    if (s->queueHead - s->queueTail < QUEUE_SIZE)
+        s->queue[s->queueHead++ % QUEUE_SIZE] = (EnemyQueue){ .spawnFrame = frame, .health = 1e9f };
+}
+
+static const char *PRIMES = "2,3,5,7,11,13,17,19,23,29,31,37,41,43,47,53,59,61,67,71,73,79,83,89,97,101,103,107,109,113,127,131";
+
+static void setupPlayground(GameState *s, int arg)
+{
+    s->home.roundingFactor = 100;
+    placeTowers(s, -1, MAX_TOWERS, true);
+}
+
+static void refillPlayground(GameState *s, unsigned int frame)
+{
+    if (s->queueHead == s->queueTail)
+        state_addQueueFromString(s, frame, PRIMES, 2, 10);
+}
+
+static void setupRounding(GameState *s, int arg)
+{
+    s->home.roundingFactor = 1000;
+    unsigned int allowed = (1 << ET_ROUND) | (1 << ET_MULT) | (1 << ET_DIV) | (1 << ET_SQRT);
+    placeTowers(s, allowed, MAX_TOWERS, true);
+}
+
+static void refillRounding(GameState *s, unsigned int frame)
+{
+    if (s->queueHead == s->queueTail)
+        state_addQueueFromString(s, frame, "1.2345,2.5,0.0049,7.77777,12.3456,0.5,3.14159,99.995", 4, 10);
+}
+
+// runs the scenario with step for SCENARIO_FRAMES frames, repeated until BENCH_MIN_SECONDS passed
+static void runScenario(Bench *b, const Scenario *sc, bool advance)
+{
+    GameState s;
+    state_init(&s);
+    HealthCache cache = { 0 };
+    if (sc->cached)
+    {
+        cache_init(&cache, HEALTH_CACHE_BITS_DEFAULT);
+        s.healthCache = &cache;
+    }
+
+    double seconds = 0;
+    double frames = 0;
+    double pairs = 0; // enemy-tower pairs looked at by level_logic
+    int allocs = 0;
+    int runs = 0;
+    while (seconds < BENCH_MIN_SECONDS)
+    {
+        state_reset(&s);
+        s.home.allowedTowers = -1;
+        s.home.roundingFactor = 100;
+        sc->setup(&s, sc->arg);
+
+        int allocStart = sim_allocationCount();
+        unsigned int frame = 0;
+        double start = thread_time();
+        while (frame < SCENARIO_FRAMES)
+        {
+            if (sc->refill)
+                sc->refill(&s, frame);
+            else if (state_isOver(&s))
+                break;
+
+            if (advance)
+            {
+                frame += level_advance(&s, frame, SCENARIO_FRAMES - frame);
+            }
+            else
+            {
+                pairs += (double)s.enemiesLen * s.towerLen;
+                level_logic(&s, frame);
+                ++frame;
+            }
+        }
+        seconds += thread_time() - start;
+        allocs += sim_allocationCount() - allocStart;
+        frames += frame;
+        ++runs;
+    }
+
+    if (advance)
+    {
+        bench_report(b, sc->name, "advance_frames_per_sec", frames / seconds, "frames/s");
+    }
+    else
+    {
+        bench_report(b, sc->name, "logic_frames_per_sec", frames / seconds, "frames/s");
+        bench_report(b, sc->name, "ns_per_enemy_tower_pair", pairs > 0 ? seconds * 1e9 / pairs : 0, "ns");
+        bench_report(b, sc->name, "avg_enemies", pairs / frames / (s.towerLen > 0 ? s.towerLen : 1), "enemies");
+        bench_report(b, sc->name, "allocations_per_run", (double)allocs / runs, "allocs");
+        if (sc->cached)
+            bench_report(b, sc->name, "cache_hit_rate", (double)cache.hits / (cache.hits + cache.misses + 1), "ratio");
+    }
+
+    state_free(&s);
+    cache_free(&cache);
+}
+
+// plays the scenario once with a rewind snapshot every REWIND_INTERVAL_DEFAULT frames,
+// then steps back through all snapshots
+static void runRewind(Bench *b, const Scenario *sc, Rewind *r)
+{
+    GameState s;
+    state_init(&s);
+    state_reset(&s);
+    s.home.allowedTowers = -1;
+    s.home.roundingFactor = 100;
+    sc->setup(&s, sc->arg);
+    rewind_clear(r);
+
+    double captureSeconds = 0;
+    double captures = 0;
+    unsigned int frame = 0;
+    while (frame < SCENARIO_FRAMES)
+    {
+        if (sc->refill)
+            sc->refill(&s, frame);
+        else if (state_isOver(&s))
+            break;
+        level_logic(&s, frame);
+        ++frame;
+
+        unsigned int count = r->count;
+        unsigned int used = r->used;
+        double start = thread_time();
+        rewind_update(r, &s, frame, 0);
+        double seconds = thread_time() - start;
+        if (r->count != count || r->used != used)
+        {
+            captureSeconds += seconds;
+            ++captures;
+        }
+    }
+
+    double start = thread_time();
+    for (int i = r->count - 1; i >= 0; --i)
+        rewind_restore(r, i, &s);
+    double stepSeconds = thread_time() - start;
+
+    char name[64];
+    snprintf(name, sizeof(name), "rewind_%.32s", sc->name);
+    double perSnapshot = r->count > 1 ? r->used / (double)(r->count - 1) : 0;
+    bench_report(b, name, "bytes_per_snapshot", perSnapshot, "bytes");
+    bench_report(b, name, "capture_ns", captures > 0 ? captureSeconds * 1e9 / captures : 0, "ns");
+    bench_report(b, name, "step_back_ns", r->count > 0 ? stepSeconds * 1e9 / r->count : 0, "ns");
+    bench_report(b, name, "game_seconds_kept", perSnapshot > 0 ? r->size / perSnapshot * r->interval / 60 : 0, "s");
+    state_free(&s);
+}
+
+// Micro benchmarks ------------------------------------------------------------
+
+// takeHealth at rounding 100, at rounding 10 and 1 (healths on the grid) the exact
+// integer math of sim_applyOpFixed for the ops it covers, to compare the two.
+static void benchTakeHealth(Bench *b, int rounding)
+{
+    enum { HEALTH_COUNT = 1024 };
+    float healths[HEALTH_COUNT];
+    for (int i = 0; i < HEALTH_COUNT; ++i)
+        healths[i] = roundf((0.5f + i * 1.37f) * rounding) / rounding;
+
+    volatile float sink = 0;
+    for (int type = ET_NONE + 1; type < ET_EOL; ++type)
+    {
+        if (rounding <= HEALTH_FIXED_MAX_ROUNDING && type > ET_SQR)
+            break;
+        Tower t = { .type = type, .scale = defaultTowerScale(type) };
+        if (type == ET_ROUND)
+            t.scale = 3;
+
+        bool fixed = rounding <= HEALTH_FIXED_MAX_ROUNDING;
+        double calls = 0;
+        double start = thread_time();
+        double seconds = 0;
+        while (seconds < BENCH_MIN_SECONDS / 4)
+        {
+            for (int i = 0; i < HEALTH_COUNT; ++i)
+            {
+                float h = healths[i];
+                TakeHealthResult result;
+                if (fixed)
+                    sim_applyOpFixed(&h, t.type, t.scale, rounding, &result);
+                else
+                    takeHealth(&h, &t, rounding);
+                sink += h;
+            }
+            calls += HEALTH_COUNT;
+            seconds = thread_time() - start;
+        }
+
+        char metric[64] = "";
+        snprintf(metric, sizeof(metric), "ns_per_call_%s", EQUATION_NAMES[type]);
+        char scenario[32] = "takeHealth";
+        if (fixed)
+            snprintf(scenario, sizeof(scenario), "takeHealth_fixed_r%d", rounding);
+        bench_report(b, scenario, metric, seconds * 1e9 / calls, "ns");
+    }
+    (void)sink;
+}
+
+// simd_applyOp on the same healths, for the ops it vectorizes
+static void benchTakeHealthBatch(Bench *b, int rounding)
+{
+    enum { HEALTH_COUNT = 1024 };
+    float healths[HEALTH_COUNT];
+    float work[HEALTH_COUNT];
+    unsigned char result[HEALTH_COUNT];
+    for (int i = 0; i < HEALTH_COUNT; ++i)
+        healths[i] = roundf((0.5f + i * 1.37f) * rounding) / rounding;
+
+    volatile float sink = 0;
+    for (int type = ET_ADD; type <= ET_SQRT; ++type)
+    {
+        double calls = 0;
+        double start = thread_time();
+        double seconds = 0;
+        while (seconds < BENCH_MIN_SECONDS / 4)
+        {
+            memcpy(work, healths, sizeof(work));
+            simd_applyOp(work, result, HEALTH_COUNT, type, defaultTowerScale(type), rounding);
+            sink += work[HEALTH_COUNT - 1];
+            calls += HEALTH_COUNT;
+            seconds = thread_time() - start;
+        }
+
+        char metric[64] = "";
+        snprintf(metric, sizeof(metric), "ns_per_health_%s", EQUATION_NAMES[type]);
+        char scenario[32] = "";
+        snprintf(scenario, sizeof(scenario), "takeHealth_batch_r%d", rounding);
+        bench_report(b, scenario, metric, seconds * 1e9 / calls, "ns");
+    }
+    (void)sink;
+}
+
+static void benchAddQueue(Bench *b)
+{
+    GameState s;
+    state_init(&s);
+
+    double calls = 0;
+    int allocStart = sim_allocationCount();
+    double start = thread_time();
+    double seconds = 0;
+    while (seconds < BENCH_MIN_SECONDS)
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            s.queueHead = s.queueTail = 0;
+            state_addQueueFromString(&s, 0, PRIMES, 2, QUEUE_SPACING_DEFAULT);
+        }
+        calls += 256;
+        seconds = thread_time() - start;
+    }
+
+    bench_report(b, "addQueueFromString", "ns_per_call", seconds * 1e9 / calls, "ns");
+    bench_report(b, "addQueueFromString", "allocations_per_call", (sim_allocationCount() - allocStart) / calls, "allocs");
+    state_free(&s);
+}
+
+// state_copy of a full field, the snapshot the simulation thread publishes every tick
+static void benchStateCopy(Bench *b)
+{
+    int allocStart = sim_allocationCount();
+    GameState s, copy;
+    state_init(&s);
+    state_init(&copy);
+    bench_report(b, "state_copy", "allocations_per_state", (sim_allocationCount() - allocStart) / 2.0, "allocs");
+    state_reset(&s);
+    setupMax(&s, 0);
+    for (unsigned int frame = 0; frame < 2000; ++frame)
+    {
+        refillMax(&s, frame);
+        level_logic(&s, frame);
+    }
+
+    double calls = 0;
+    double start = thread_time();
+    double seconds = 0;
+    while (seconds < BENCH_MIN_SECONDS)
+    {
+        for (int i = 0; i < 256; ++i)
+            state_copy(&copy, &s);
+        calls += 256;
+        seconds = thread_time() - start;
+    }
+    bench_report(b, "state_copy", "ns_per_copy", seconds * 1e9 / calls, "ns");
+    bench_report(b, "state_copy", "bytes_per_copy", s.blockCopyBytes, "bytes");
+    state_free(&s);
+    state_free(&copy);
+}
+
+int main(int argc, char **argv)
+{
+    const char *filename = argc > 1 ? argv[1] : "bench_output.txt";
+    Bench b = { .out = fopen(filename, "w") };
+    if (b.out == NULL)
+    {
+        printf("ERROR: Could not open %s\n", filename);
+        return 1;
+    }
+    fprintf(b.out, "scenario,metric,value,unit\n");
+
+    Scenario scenarios[ARRAY_SIZE(LEVELS) + 5];
+    int scenarioLen = 0;
+    for (int i = 0; i < (int)ARRAY_SIZE(LEVELS); ++i)
+    {
+        scenarios[scenarioLen] = (Scenario){ .setup = setupLevel, .arg = i };
+        snprintf(scenarios[scenarioLen].name, sizeof(scenarios[0].name), "level_%02d", i);
+        ++scenarioLen;
+    }
+    scenarios[scenarioLen++] = (Scenario){ "max_towers_enemies", setupMax, refillMax };
+    scenarios[scenarioLen++] = (Scenario){ "playground_wave", setupPlayground, refillPlayground };
+    scenarios[scenarioLen++] = (Scenario){ "rounding_mix", setupRounding, refillRounding };
+    scenarios[scenarioLen++] = (Scenario){ "playground_wave_cached", setupPlayground, refillPlayground, .cached = true };
+    scenarios[scenarioLen++] = (Scenario){ "rounding_mix_cached", setupRounding, refillRounding, .cached = true };
+
+    for (int i = 0; i < scenarioLen; ++i)
+    {
+        runScenario(&b, scenarios + i, false);
+        runScenario(&b, scenarios + i, true);
+    }
+    Rewind rewindBuffer; // rewind() is taken by stdio
+    rewind_init(&rewindBuffer, REWIND_SIZE_DEFAULT, REWIND_INTERVAL_DEFAULT);
+    bench_report(&b, "rewind", "memory", rewind_memory(&rewindBuffer), "bytes");
+    for (int i = 0; i < scenarioLen; ++i)
+    {
+        if (!scenarios[i].cached)
+            runRewind(&b, scenarios + i, &rewindBuffer);
+    }
+    rewind_free(&rewindBuffer);
+    benchTakeHealth(&b, 100);
+    benchTakeHealth(&b, 10);
+    benchTakeHealth(&b, 1);
+    benchTakeHealthBatch(&b, 100);
+    benchTakeHealthBatch(&b, 1);
+    benchAddQueue(&b);
+    benchStateCopy(&b);
+
+    fclose(b.out);
+    return 0;
+}
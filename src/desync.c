@@ -0,0 +1,282 @@
+// Finds where two builds of the simulation part ways on the same replay (e.g. the
+// Windows build and the web build, see build_web.sh). Each build writes a trace of the
+// state hash (StateHash in src/sim.h) while playing the replay, then one of them
+// compares the two traces:
+//   desync trace <replay file> <trace file>
+//   desync compare <trace file> <trace file>
+// compare prints the first tick at which the traces differ with its frame and the
+// hash fields that differ, and exits with 1 then.
+//
+// The replay is played with level_logic one frame after the other (not level_advance)
+// so every tick of the game is covered. The hash of the game leaves out enemies that
+// only move, so the trace adds one more field, movement: the position of every live
+// enemy after every tick, mixed into a chain by sim_hashMix like the others. A
+// difference in float movement shows up there at the tick it happens, not when it
+// changes a shot later on. A trace is a text file, after a header line one line per
+// tick in which a field changed, which is every tick while enemies are on the field:
+//   <tick> <frame> <hash field>... movement (hexadecimal, in the order of HASH_FIELD_NAMES)
+// tick counts the frames simulated since the start of the replay, frame is the frame
+// of the simulation, which starts over at every restart. The commands of a frame are
+// applied before its tick, like in the game. The last line is always the end.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+#include "replay.h"
+
+#define DESYNC_LINE_MAX 256
+#define TRACE_MOVEMENT HF_EOL // the field only traces have
+#define TRACE_FIELDS (HF_EOL + 1)
+
+typedef struct TraceLine
+{
+    unsigned int tick;
+    unsigned int frame;
+    unsigned int field[TRACE_FIELDS];
+} TraceLine;
+
+static const char *fieldName(int field)
+{
+    return field == TRACE_MOVEMENT ? "movement" : HASH_FIELD_NAMES[field];
+}
+
+// mixes the position of every live enemy into movement
+static unsigned int mixMovement(unsigned int movement, const GameState *s)
+{
+    const EnemyList *e = &s->enemies;
+    for (unsigned int i = 0; i < s->enemiesLen; ++i)
+    {
+        unsigned int x, y;
+        memcpy(&x, e->x + i, sizeof(x));
+        memcpy(&y, e->y + i, sizeof(y));
+        movement = sim_hashMix(movement, e->handle[i] & ((1u << ENEMY_HANDLE_SLOT_BITS) - 1));
+        movement = sim_hashMix(movement, x);
+        movement = sim_hashMix(movement, y);
+    }
+    return movement;
+}
+
+static void trace_set(TraceLine *t, unsigned int tick, unsigned int frame, const StateHash *h, unsigned int movement)
+{
+    t->tick = tick;
+    t->frame = frame;
+    memcpy(t->field, h->field, sizeof(h->field));
+    t->field[TRACE_MOVEMENT] = movement;
+}
+
+static void trace_write(FILE *f, const TraceLine *t)
+{
+    fprintf(f, "%u %u", t->tick, t->frame);
+    for (int i = 0; i < TRACE_FIELDS; ++i)
+        fprintf(f, " %08x", t->field[i]);
+    fputc('\n', f);
+}
+
+// plays replay and writes its trace to f, returns false if the replay is not valid
+static bool trace_play(FILE *f, const Replay *replay, const char *replayFile)
+{
+    // the health cache gives the same results as without, leave it out so the trace
+    // only depends on the simulation
+    GameState state;
+    state_init(&state);
+    ReplayReader reader;
+    unsigned int frame = 0;
+    unsigned int tick = 0;
+    if (!replay_start(&reader, replay, &state, &frame))
+    {
+        printf("%s: ERROR: not a valid replay\n", replayFile);
+        state_free(&state);
+        return false;
+    }
+    unsigned int movement = 0;
+    TraceLine written, line;
+    trace_set(&written, tick, frame, &state.hash, movement);
+    trace_write(f, &written);
+
+    ReplayEvent e;
+    bool more;
+    int diverged = 0;
+    do
+    {
+        more = replay_next(&reader, &e);
+        if (reader.error)
+        {
+            printf("%s: ERROR: not a valid replay\n", replayFile);
+            state_free(&state);
+            return false;
+        }
+        // frames may wrap around, the event is never behind
+        while (frame != e.frame)
+        {
+            level_logic(&state, frame++);
+            ++tick;
+            movement = mixMovement(movement, &state);
+            trace_set(&line, tick, frame, &state.hash, movement);
+            if (memcmp(line.field, written.field, sizeof(line.field)) != 0)
+            {
+                written = line;
+                trace_write(f, &written);
+            }
+        }
+        // the trace goes on, the other build may have played out like this too
+        if (more && e.type == RE_COMMAND && sim_applyCommand(&state, &frame, &e.command) != e.accepted)
+            ++diverged;
+    } while (more);
+    trace_set(&line, tick, frame, &state.hash, movement);
+    trace_write(f, &line);
+
+    if (diverged > 0)
+        printf("%s: WARNING: %d command(s) got another result than when recorded\n", replayFile, diverged);
+    printf("%s: %u ticks, hash %08x\n", replayFile, tick, state_hash(&state));
+    state_free(&state);
+    return true;
+}
+
+static int trace(const char *replayFile, const char *traceFile)
+{
+    Replay replay;
+    replay_init(&replay, REPLAY_SIZE_DEFAULT);
+    if (!replay_load(&replay, replayFile))
+    {
+        printf("%s: ERROR: Could not read file\n", replayFile);
+        replay_free(&replay);
+        return 1;
+    }
+    FILE *f = fopen(traceFile, "w");
+    if (f == NULL)
+    {
+        printf("%s: ERROR: Could not write file\n", traceFile);
+        replay_free(&replay);
+        return 1;
+    }
+
+    fprintf(f, "tick frame");
+    for (int i = 0; i < TRACE_FIELDS; ++i)
+        fprintf(f, " %s", fieldName(i));
+    fputc('\n', f);
+    bool ok = trace_play(f, &replay, replayFile);
+    if (fclose(f) != 0)
+    {
+        printf("%s: ERROR: Could not write file\n", traceFile);
+        ok = false;
+    }
+    replay_free(&replay);
+    return ok ? 0 : 1;
+}
+
+// returns false at the end of the file, *error is set if the line is malformed
+static bool trace_read(FILE *f, TraceLine *t, bool *error)
+{
+    char line[DESYNC_LINE_MAX];
+    if (!fgets(line, sizeof(line), f))
+        return false;
+    char *pos = line;
+    char *end;
+    t->tick = strtoul(pos, &end, 10);
+    *error |= (end == pos);
+    pos = end;
+    t->frame = strtoul(pos, &end, 10);
+    *error |= (end == pos);
+    for (int i = 0; i < TRACE_FIELDS; ++i)
+    {
+        pos = end;
+        t->field[i] = strtoul(pos, &end, 16);
+        *error |= (end == pos);
+    }
+    return !*error;
+}
+
+static int compare(const char *fileA, const char *fileB)
+{
+    const char *files[2] = { fileA, fileB };
+    FILE *f[2] = { NULL, NULL };
+    char header[DESYNC_LINE_MAX];
+    for (int i = 0; i < 2; ++i)
+    {
+        f[i] = fopen(files[i], "r");
+        if (f[i] == NULL || !fgets(header, sizeof(header), f[i]))
+        {
+            printf("%s: ERROR: Could not read file\n", files[i]);
+            for (int j = 0; j <= i; ++j)
+            {
+                if (f[j])
+                    fclose(f[j]);
+            }
+            return 1;
+        }
+    }
+
+    // both start with the same state, until a line differs the builds agree
+    TraceLine line[2] = { 0 };
+    TraceLine prev[2] = { 0 };
+    bool more[2] = { true, true };
+    bool error = false;
+    unsigned int lines = 0;
+    int result = 0;
+    for (;;)
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            prev[i] = line[i];
+            more[i] = trace_read(f[i], line + i, &error);
+        }
+        if (error)
+        {
+            printf("ERROR: malformed trace line %u\n", lines + 2);
+            result = 1;
+            break;
+        }
+        if (!more[0] && !more[1])
+        {
+            printf("traces match: %u changes, %u ticks\n", lines, prev[0].tick);
+            break;
+        }
+        if (more[0] && more[1] && memcmp(line, line + 1, sizeof(line[0])) == 0)
+        {
+            ++lines;
+            continue;
+        }
+
+        // The earlier of the two lines is the first tick at which they differ, the
+        // other build was still at its line before then. A trace that ended stays at
+        // its last line.
+        TraceLine at[2];
+        int first;
+        if (!more[0] || !more[1])
+            first = more[0] ? 0 : 1;
+        else
+            first = line[0].tick <= line[1].tick ? 0 : 1;
+        unsigned int tick = line[first].tick;
+        for (int i = 0; i < 2; ++i)
+            at[i] = (more[i] && line[i].tick == tick) ? line[i] : prev[i];
+
+        printf("first difference at tick %u, frame %u\n", tick, line[first].frame);
+        for (int i = 0; i < TRACE_FIELDS; ++i)
+        {
+            if (at[0].field[i] != at[1].field[i])
+                printf("  %-14s %08x in %s, %08x in %s\n", fieldName(i), at[0].field[i], files[0], at[1].field[i], files[1]);
+        }
+        if (!more[1 - first])
+            printf("  %s ended at tick %u\n", files[1 - first], prev[1 - first].tick);
+        result = 1;
+        break;
+    }
+
+    fclose(f[0]);
+    fclose(f[1]);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 4 && strcmp(argv[1], "trace") == 0)
+        return trace(argv[2], argv[3]);
+    if (argc == 4 && strcmp(argv[1], "compare") == 0)
+        return compare(argv[2], argv[3]);
+
+    printf("Usage: desync trace <replay file> <trace file>\n");
+    printf("       desync compare <trace file> <trace file>\n");
+    return 1;
+}
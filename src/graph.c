@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "graph.h"
+
+static unsigned int healthBits(float health)
+{
+    unsigned int bits;
+    memcpy(&bits, &health, sizeof(bits));
+    return bits;
+}
+
+static unsigned int slotOf(const HealthGraph *g, float health)
+{
+    // the low mantissa bits of round healths are all zero, mix the high bits down
+    unsigned int h = healthBits(health) * 0x9E3779B1u;
+    return (h ^ (h >> 16)) & g->slotMask;
+}
+
+int graph_node(const HealthGraph *g, float health)
+{
+    if (health == 0)
+        return GRAPH_NODE_DEAD;
+    for (unsigned int s = slotOf(g, health); g->slots[s] != 0; s = (s + 1) & g->slotMask)
+    {
+        if (healthBits(g->health[g->slots[s]]) == healthBits(health))
+            return g->slots[s];
+    }
+    return -1;
+}
+
+// returns the node of health, adding it if there is room, GRAPH_NODE_UNEXPLORED if not
+static int graph_add(HealthGraph *g, float health, int maxNodes)
+{
+    unsigned int s = slotOf(g, health);
+    for (; g->slots[s] != 0; s = (s + 1) & g->slotMask)
+    {
+        if (healthBits(g->health[g->slots[s]]) == healthBits(health))
+            return g->slots[s];
+    }
+    if (g->nodeLen >= maxNodes)
+        return GRAPH_NODE_UNEXPLORED;
+    g->health[g->nodeLen] = health;
+    g->slots[s] = g->nodeLen;
+    return g->nodeLen++;
+}
+
+// Breadth first search backwards from death. The unexplored node joins right after
+// death's own predecessors, at distance 1.
+static bool graph_distances(HealthGraph *g)
+{
+    int *reverseStart = calloc(g->nodeLen + 1, sizeof(int));
+    int *reverseSource = malloc((g->edgeLen + 1) * sizeof(int));
+    int *queue = malloc(g->nodeLen * sizeof(int));
+    if (!reverseStart || !reverseSource || !queue)
+    {
+        free(reverseStart);
+        free(reverseSource);
+        free(queue);
+        return false;
+    }
+
+    for (int e = 0; e < g->edgeLen; ++e)
+        ++reverseStart[g->edgeTarget[e] + 1];
+    for (int i = 0; i < g->nodeLen; ++i)
+        reverseStart[i + 1] += reverseStart[i];
+    for (int i = 0; i < g->nodeLen; ++i)
+    {
+        for (int e = g->edgeStart[i]; e < g->edgeStart[i + 1]; ++e)
+            reverseSource[reverseStart[g->edgeTarget[e]]++] = i;
+    }
+    // the fill moved every start to the next one
+    for (int i = g->nodeLen; i > 0; --i)
+        reverseStart[i] = reverseStart[i - 1];
+    reverseStart[0] = 0;
+
+    memset(g->distance, GRAPH_UNREACHABLE, g->nodeLen);
+    int len = 0;
+    queue[len++] = GRAPH_NODE_DEAD;
+    g->distance[GRAPH_NODE_DEAD] = 0;
+    for (int head = 0; head < len; ++head)
+    {
+        int n = queue[head];
+        int d = MIN(g->distance[n] + 1, GRAPH_UNREACHABLE - 1);
+        for (int e = reverseStart[n]; e < reverseStart[n + 1]; ++e)
+        {
+            int p = reverseSource[e];
+            if (g->distance[p] != GRAPH_UNREACHABLE)
+                continue;
+            g->distance[p] = d;
+            queue[len++] = p;
+        }
+        if (n == GRAPH_NODE_DEAD)
+        {
+            g->distance[GRAPH_NODE_UNEXPLORED] = 1;
+            queue[len++] = GRAPH_NODE_UNEXPLORED;
+        }
+    }
+
+    free(reverseStart);
+    free(reverseSource);
+    free(queue);
+    return true;
+}
+
+bool graph_build(HealthGraph *g, const SolverLevel *l, int maxNodes, float maxHealth)
+{
+    *g = (HealthGraph){ .opsLen = l->opsLen, .roundingFactor = l->roundingFactor };
+    memcpy(g->ops, l->ops, l->opsLen * sizeof(SolverOp));
+    if (maxNodes < l->healthLen)
+        maxNodes = l->healthLen;
+    maxNodes += 2; // dead and unexplored
+    unsigned int slotLen = 1;
+    while (slotLen < (unsigned int)maxNodes * 2)
+        slotLen *= 2;
+    g->slotMask = slotLen - 1;
+
+    g->health = malloc(maxNodes * sizeof(float));
+    g->edgeStart = malloc((maxNodes + 1) * sizeof(int));
+    g->edgeTarget = malloc((maxNodes * l->opsLen + 1) * sizeof(int));
+    g->edgeOp = malloc(maxNodes * l->opsLen + 1);
+    g->distance = malloc(maxNodes);
+    g->slots = calloc(slotLen, sizeof(int));
+    if (!g->health || !g->edgeStart || !g->edgeTarget || !g->edgeOp || !g->distance || !g->slots)
+    {
+        graph_free(g);
+        return false;
+    }
+
+    g->health[GRAPH_NODE_DEAD] = 0;
+    g->health[GRAPH_NODE_UNEXPLORED] = NAN;
+    g->nodeLen = 2;
+    for (int i = 0; i < l->healthLen; ++i)
+        graph_add(g, l->health[i], maxNodes);
+
+    HealthCache cache;
+    cache_init(&cache, HEALTH_CACHE_BITS_DEFAULT);
+    g->edgeStart[GRAPH_NODE_DEAD] = g->edgeStart[GRAPH_NODE_UNEXPLORED] = 0;
+    // nodes are expanded in the order they are found, so the edges come out in CSR order
+    for (int i = 2; i < g->nodeLen; ++i)
+    {
+        g->edgeStart[i] = g->edgeLen;
+        for (int o = 0; o < l->opsLen; ++o)
+        {
+            float h = g->health[i];
+            if (!canTarget(l->ops[o].type, h))
+                continue;
+            int target = GRAPH_NODE_DEAD;
+            if (cache_applyOp(&cache, &h, l->ops[o].type, l->ops[o].scale, l->roundingFactor) != TH_DEAD)
+            {
+                if (!isfinite(h))
+                    continue; // can never die
+                target = fabsf(h) > maxHealth ? GRAPH_NODE_UNEXPLORED : graph_add(g, h, maxNodes);
+            }
+            if (target == i)
+                continue;
+            g->edgeTarget[g->edgeLen] = target;
+            g->edgeOp[g->edgeLen] = o;
+            ++g->edgeLen;
+        }
+    }
+    g->edgeStart[g->nodeLen] = g->edgeLen;
+    cache_free(&cache);
+
+    if (!graph_distances(g))
+    {
+        graph_free(g);
+        return false;
+    }
+    return true;
+}
+
+void graph_free(HealthGraph *g)
+{
+    free(g->health);
+    free(g->edgeStart);
+    free(g->edgeTarget);
+    free(g->edgeOp);
+    free(g->distance);
+    free(g->slots);
+    *g = (HealthGraph){ 0 };
+}
+
+int graph_distance(const HealthGraph *g, float health)
+{
+    int n = graph_node(g, health);
+    return n >= 0 ? g->distance[n] : 1;
+}
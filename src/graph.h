@@ -0,0 +1,51 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+// Health reachability graph of a level: nodes are the healths an enemy can have
+// (rounding keeps them on a finite grid), edges are the tower ops of the level. Built
+// by exploring from the starting healths, stored in compressed sparse row form (the
+// edges of node i are edgeStart[i] to edgeStart[i + 1] - 1). Answers "fewest ops to
+// kill an enemy with health h" with a lookup, the solver uses that to cut sets that
+// need more ops than are left. solver_solve builds one per call once the search runs
+// long, the hint search keeps one per level across its restarts.
+//
+// The exploration stops at maxNodes nodes and at healths above maxHealth. Everything
+// beyond is one node (GRAPH_NODE_UNEXPLORED) that counts as one op away from death,
+// so distances are lower bounds, never too high.
+
+#include "solver.h"
+
+#define GRAPH_MAX_NODES_DEFAULT (1 << 16)
+#define GRAPH_MAX_HEALTH_DEFAULT 10000.0f
+#define GRAPH_NODE_DEAD 0
+#define GRAPH_NODE_UNEXPLORED 1
+#define GRAPH_UNREACHABLE 255 // distance of healths that can never die
+
+typedef struct HealthGraph
+{
+    float *health; // of each node
+    int nodeLen;
+    int *edgeStart; // nodeLen + 1 entries
+    int *edgeTarget;
+    unsigned char *edgeOp; // index into ops
+    int edgeLen;
+    unsigned char *distance; // fewest ops to GRAPH_NODE_DEAD
+    SolverOp ops[ET_EOL];
+    int opsLen;
+    int roundingFactor;
+
+    // health -> node, open addressing on the float bits, 0: empty
+    int *slots;
+    unsigned int slotMask;
+} HealthGraph;
+
+// explores from the healths of l with the ops of l, returns false if out of memory
+bool graph_build(HealthGraph *g, const SolverLevel *l, int maxNodes, float maxHealth);
+void graph_free(HealthGraph *g);
+// node of health, -1 if it was not explored
+int graph_node(const HealthGraph *g, float health);
+// Fewest ops to kill an enemy with health (lower bound, see above). Healths outside the
+// graph are alive, so 1.
+int graph_distance(const HealthGraph *g, float health);
+
+#endif // GRAPH_H
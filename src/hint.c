@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "hint.h"
+#include "thread.h"
+
+#define HINT_SLICE 64 // nodes between looks at the clock
+
+typedef struct Placed
+{
+    int index;
+    float enter;
+} Placed;
+
+// x at which enemies on the path come into range of a tower centered at (x, y), -1 if
+// never. Capped at the spawn: the towers that see an enemy spawn fire in index order.
+static float enterX(float x, float y)
+{
+    float reach = TOWER_RANGE + ENEMY_SIZE;
+    float dy = fabsf(y - ENEMY_SPAWN_Y);
+    if (dy >= reach)
+        return -1;
+    return MIN(x + sqrtf(reach * reach - dy * dy), ENEMY_SPAWN_X);
+}
+
+// first in range first, ties in tower index order
+static int comparePlaced(const void *a, const void *b)
+{
+    const Placed *x = a;
+    const Placed *y = b;
+    if (x->enter != y->enter)
+        return x->enter < y->enter ? 1 : -1;
+    return x->index - y->index;
+}
+
+// Builds the search inputs from state into h (level, fixed towers and insert tiles).
+static void hint_inputs(Hint *h, const GameState *s)
+{
+    Placed placed[MAX_TOWERS];
+    int placedLen = 0;
+    bool used[FIELD_HEIGHT / TOWER_SIZE][FIELD_WIDTH / TOWER_SIZE] = { 0 };
+    for (unsigned int i = 0; i < s->towerLen; ++i)
+    {
+        const Tower *t = s->towers + i;
+        used[(int)t->rect.y / TOWER_SIZE][(int)t->rect.x / TOWER_SIZE] = true;
+        float enter = enterX(t->center.x, t->center.y);
+        if (enter >= 0)
+            placed[placedLen++] = (Placed){ i, enter };
+    }
+    qsort(placed, placedLen, sizeof(Placed), comparePlaced);
+    h->fixedLen = placedLen;
+    for (int i = 0; i < placedLen; ++i)
+    {
+        const Tower *t = s->towers + placed[i].index;
+        h->fixed[i] = (SolverOp){ t->type, t->scale };
+    }
+
+    // queued enemies and the ones still ahead of every tower
+    float health[QUEUE_SIZE + MAX_ENEMIES];
+    int healthLen = 0;
+    for (unsigned int i = s->queueTail; i != s->queueHead; ++i)
+        health[healthLen++] = s->queue[i].health;
+    for (unsigned int i = 0; i < s->enemiesLen; ++i)
+    {
+        if (s->enemies.towersHit[i] == 0 && (placedLen == 0 || s->enemies.x[i] > placed[0].enter))
+            health[healthLen++] = s->enemies.health[i];
+    }
+    solver_initHealths(&h->level, health, healthLen, s->home.allowedTowers, s->home.roundingFactor);
+
+    // Inserting before fixed tower p: the latest tile that comes into range after
+    // tower p - 1 (or with it, the new tower has the highest index) and before tower p.
+    // The latest leaves the most room for further towers in the same gap.
+    const int ROWS[] = { 3, 5, 2, 6 };
+    for (int p = 0; p <= placedLen; ++p)
+    {
+        float upper = p > 0 ? placed[p - 1].enter : ENEMY_SPAWN_X;
+        float lower = p < placedLen ? placed[p].enter : -1;
+        float best = -1;
+        h->tileX[p] = h->tileY[p] = -1;
+        for (int x = FIELD_WIDTH / TOWER_SIZE - 1; x >= HINT_MIN_TILE_X; --x)
+        {
+            for (int r = 0; r < (int)ARRAY_SIZE(ROWS); ++r)
+            {
+                float enter = enterX((x + 0.5f) * TOWER_SIZE, (ROWS[r] + 0.5f) * TOWER_SIZE);
+                if (used[ROWS[r]][x] || enter > upper || enter <= lower || enter <= best)
+                    continue;
+                best = enter;
+                h->tileX[p] = x;
+                h->tileY[p] = ROWS[r];
+            }
+        }
+    }
+}
+
+static bool sameInputs(const Hint *a, const Hint *b)
+{
+    const SolverLevel *x = &a->level;
+    const SolverLevel *y = &b->level;
+    return x->healthLen == y->healthLen
+        && memcmp(x->health, y->health, x->healthLen * sizeof(float)) == 0
+        && x->opsLen == y->opsLen
+        && memcmp(x->ops, y->ops, x->opsLen * sizeof(SolverOp)) == 0
+        && x->roundingFactor == y->roundingFactor
+        && a->fixedLen == b->fixedLen
+        && memcmp(a->fixed, b->fixed, a->fixedLen * sizeof(SolverOp)) == 0
+        && memcmp(a->tileX, b->tileX, (a->fixedLen + 1) * sizeof(int)) == 0
+        && memcmp(a->tileY, b->tileY, (a->fixedLen + 1) * sizeof(int)) == 0;
+}
+
+void hint_init(Hint *h)
+{
+    *h = (Hint){ 0 };
+    hint_reset(h);
+}
+
+void hint_free(Hint *h)
+{
+    solver_hintEnd(&h->search);
+}
+
+void hint_reset(Hint *h)
+{
+    h->status = HINT_RUNNING;
+    h->stale = false;
+    h->tower = (SimCommand){ .type = CMD_NONE };
+    h->towersLeft = 0;
+    h->fixedLen = -1; // restarts on the next update
+}
+
+void hint_update(Hint *h, const GameState *state, double budgetSeconds)
+{
+    double start = thread_time();
+
+    Hint next; // only the inputs are used
+    hint_inputs(&next, state);
+    if (!sameInputs(h, &next))
+    {
+        h->level = next.level;
+        h->fixedLen = next.fixedLen;
+        memcpy(h->fixed, next.fixed, sizeof(h->fixed));
+        memcpy(h->tileX, next.tileX, sizeof(h->tileX));
+        memcpy(h->tileY, next.tileY, sizeof(h->tileY));
+        unsigned long long insertAllowed = 0;
+        for (int p = 0; p <= h->fixedLen; ++p)
+        {
+            if (h->tileX[p] >= 0)
+                insertAllowed |= 1ull << p;
+        }
+        int maxInsert = MIN(HINT_MAX_INSERT, MAX_TOWERS - (int)state->towerLen);
+        solver_hintBegin(&h->search, &h->level, h->fixed, h->fixedLen, insertAllowed, maxInsert);
+        h->stale = true;
+    }
+
+    while (h->search.status == HINT_RUNNING && thread_time() - start < budgetSeconds)
+        solver_hintStep(&h->search, HINT_SLICE);
+
+    if (h->search.status == HINT_RUNNING || !h->stale)
+        return;
+    h->status = h->search.status;
+    h->stale = false;
+    h->towersLeft = h->search.towersLeft;
+    h->tower = (SimCommand){ .type = CMD_NONE };
+    if (h->status == HINT_FOUND && h->search.position >= 0)
+    {
+        h->tower = (SimCommand){
+            .type = CMD_ADD_TOWER,
+            .tileX = h->tileX[h->search.position],
+            .tileY = h->tileY[h->search.position],
+            .tower = h->search.op.type,
+            .scale = h->search.op.scale,
+        };
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef HINT_H
+#define HINT_H
+
+// In-game hint: suggests the next tower on the way to the fewest towers that still
+// win. The towers already placed stay where they are, the solver (solver_hint*)
+// looks for the fewest towers to add around them. hint_update gives the search a
+// slice of time every frame and restarts it whenever the towers or the enemies it
+// is based on change, so a hard level takes a few frames instead of a frame spike.
+//
+// The model is the one of the par solver: every enemy meets the towers in the order
+// they come into range. Enemies that already came into range of a tower are not
+// part of it (they are half way through the sequence), neither are healths beyond
+// SOLVER_MAX_HEALTHS distinct ones.
+
+#include "sim.h"
+#include "solver.h"
+
+#define HINT_MAX_INSERT 8
+#define HINT_BUDGET_DEFAULT 0.002 // seconds per frame
+#define HINT_MIN_TILE_X 2 // towers further left may not fire before enemies are home
+
+typedef struct Hint
+{
+    HintSearch search;
+    // inputs of the running search, any change restarts it
+    SolverLevel level;
+    SolverOp fixed[MAX_TOWERS];
+    int fixedLen;
+    int tileX[MAX_TOWERS + 1]; // tile for a tower inserted before fixed tower i, -1: none
+    int tileY[MAX_TOWERS + 1];
+
+    // latest finished search
+    HintStatus status; // HINT_RUNNING: none finished yet
+    bool stale; // the inputs changed since, a new search is running
+    SimCommand tower; // CMD_NONE if the placed towers already win
+    int towersLeft; // to add, including tower
+} Hint;
+
+void hint_init(Hint *h);
+void hint_free(Hint *h);
+// forgets the last suggestion, e.g. when the level changes
+void hint_reset(Hint *h);
+// Restarts the search if state changed, then searches for about budgetSeconds.
+void hint_update(Hint *h, const GameState *state, double budgetSeconds);
+
+#endif // HINT_H
@@ -0,0 +1,271 @@
+// Generates random levels, keeps the ones the solver can beat and ranks them.
+// Usage: levelgen [candidate count] [seed] [output file]
+// The kept levels go to levelgen_output.txt by default, best first, written as
+// LevelDef entries that can be pasted into LEVELS (src/levels.h). Candidates are
+// spread over all cores; candidate i only depends on seed and i, so the output does
+// not depend on the thread count.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "sim.h"
+#include "solver.h"
+#include "thread.h"
+
+#define LEVELGEN_COUNT_DEFAULT 1000
+#define LEVELGEN_MIN_PAR 3 // easier levels are not interesting
+#define LEVELGEN_MAX_PAR 8 // also bounds the search time of unsolvable candidates
+#define LEVELGEN_HEALTHS_MAX 8
+
+typedef struct Candidate
+{
+    LevelDef def;
+    char name[32];
+    char health[128];
+    int par; // -1: rejected
+    Solution solution;
+    int rank;
+} Candidate;
+
+typedef struct Generator
+{
+    Candidate *candidates;
+    int candidateLen;
+    unsigned int seed;
+    volatile int next;
+} Generator;
+
+// towers a category adds on top of the ones before it
+static const unsigned int CATEGORY_TOWERS[LC_EOL] = {
+    (1 << ET_ADD) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV),
+    (1 << ET_SQR) | (1 << ET_SQRT),
+    (1 << ET_LOG_10),
+    0,
+};
+static const int CATEGORY_ROUNDING[LC_EOL] = { 1, 1, 10, 100 };
+
+static unsigned int random_next(unsigned int *state)
+{
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// in [min, max]
+static int random_range(unsigned int *state, int min, int max)
+{
+    return min + (int)(random_next(state) % (unsigned int)(max - min + 1));
+}
+
+static int countBits(unsigned int x)
+{
+    int count = 0;
+    for (; x != 0; x &= x - 1)
+        ++count;
+    return count;
+}
+
+static float randomHealth(unsigned int *r, LevelCat cat)
+{
+    switch (cat)
+    {
+        case LC_NATURAL: return random_range(r, 1, 64);
+        case LC_INTEGER: return random_range(r, 1, 32) * (random_next(r) % 2 ? 1 : -1);
+        case LC_RATIONAL: return random_range(r, 1, 200) / 10.0f * (random_next(r) % 2 ? 1 : -1);
+        default: return random_range(r, 1, 1000) / 100.0f;
+    }
+}
+
+static void generate(Candidate *c, unsigned int seed, int index)
+{
+    unsigned int r = (seed * 0x9E3779B1u) ^ (index * 0x85EBCA77u);
+    r = r != 0 ? r : 1;
+    for (int i = 0; i < 4; ++i)
+        random_next(&r);
+
+    LevelCat cat = random_range(&r, LC_NATURAL, LC_EOL - 1);
+    unsigned int pool = 0;
+    for (int i = 0; i <= cat; ++i)
+        pool |= CATEGORY_TOWERS[i];
+    unsigned int allowed = 0;
+    while (countBits(allowed) < 2)
+    {
+        for (int type = ET_NONE + 1; type < ET_EOL; ++type)
+        {
+            if ((pool & (1 << type)) && random_next(&r) % 4 != 0)
+                allowed |= 1 << type;
+        }
+    }
+
+    // a progression (every step the same difference or factor) or random values
+    int healthLen = random_range(&r, 2, LEVELGEN_HEALTHS_MAX);
+    float health[LEVELGEN_HEALTHS_MAX];
+    int kind = random_range(&r, 0, 2);
+    float start = randomHealth(&r, cat);
+    float step = (kind == 1) ? random_range(&r, 1, 8) : random_range(&r, 2, 3);
+    for (int i = 0; i < healthLen; ++i)
+    {
+        if (kind == 0)
+            health[i] = randomHealth(&r, cat);
+        else if (kind == 1)
+            health[i] = start + i * step;
+        else
+            health[i] = start * powf(step, i);
+        if (health[i] == 0)
+            health[i] = step; // a zero entry is skipped by the queue
+    }
+
+    int len = 0;
+    for (int i = 0; i < healthLen && len < (int)sizeof(c->health) - 16; ++i)
+        len += snprintf(c->health + len, sizeof(c->health) - len, "%s%g", i > 0 ? "," : "", health[i]);
+    snprintf(c->name, sizeof(c->name), "Generated %d", index);
+
+    c->def = (LevelDef){
+        .name = c->name,
+        .cat = cat,
+        .health = c->health,
+        .count = random_range(&r, 1, 5),
+        .spacing = QUEUE_SPACING_DEFAULT,
+        .towersAllowed = (1 << ET_NONE) | allowed,
+        .roundingFactor = CATEGORY_ROUNDING[cat],
+    };
+}
+
+// Higher is better: longer pars, solutions that mix many towers and allowed towers
+// the solution does not need (red herrings).
+static int rankCandidate(const Candidate *c)
+{
+    unsigned int used = 0;
+    for (int i = 0; i < c->solution.len; ++i)
+        used |= 1u << c->solution.ops[i].type;
+    int herrings = countBits(c->def.towersAllowed & ~used & ~(1u << ET_NONE));
+    return c->par * 4 + countBits(used) * 3 + MIN(herrings, 2);
+}
+
+static void worker(void *arg)
+{
+    Generator *g = arg;
+    GameState state;
+    state_init(&state);
+    HealthCache cache;
+    cache_init(&cache, HEALTH_CACHE_BITS_DEFAULT);
+    state.healthCache = &cache;
+
+    int i;
+    while ((i = atomic_add(&g->next, 1)) < g->candidateLen)
+    {
+        Candidate *c = g->candidates + i;
+        generate(c, g->seed, i);
+
+        SolverLevel level;
+        solver_initLevel(&level, &c->def);
+        c->par = solver_solve(&level, LEVELGEN_MAX_PAR, &c->solution);
+        // the game has to agree with the solver
+        if (c->par < LEVELGEN_MIN_PAR || solver_playSolution(&state, &c->def, 0, &c->solution) != HEALTH_DEFAULT)
+        {
+            c->par = -1;
+            continue;
+        }
+        c->def.minSolution = c->par;
+        c->rank = rankCandidate(c);
+    }
+
+    state_free(&state);
+    cache_free(&cache);
+}
+
+static int compareCandidates(const void *a, const void *b)
+{
+    const Candidate *x = a;
+    const Candidate *y = b;
+    if (x->rank != y->rank)
+        return y->rank - x->rank;
+    return strcmp(x->name, y->name);
+}
+
+static void writeLevel(FILE *f, const Candidate *c)
+{
+    const LevelDef *l = &c->def;
+    const char *CATEGORY_NAMES[LC_EOL] = { "LC_NATURAL", "LC_INTEGER", "LC_RATIONAL", "LC_REAL" };
+    char solution[256] = "";
+    solver_describe(&c->solution, solution, sizeof(solution));
+
+    fprintf(f, "    {\n");
+    fprintf(f, "        .name = \"%s\", // rank %d\n", l->name, c->rank);
+    fprintf(f, "        .cat = %s,\n", CATEGORY_NAMES[l->cat]);
+    fprintf(f, "        .health = \"%s\",\n", l->health);
+    fprintf(f, "        .count = %d,\n", l->count);
+    fprintf(f, "        .spacing = QUEUE_SPACING_DEFAULT,\n");
+    fprintf(f, "        .towersAllowed = (1 << ET_NONE)");
+    for (int type = ET_NONE + 1; type < ET_EOL; ++type)
+    {
+        if ((l->towersAllowed & (1u << type)) == 0)
+            continue;
+        char upper[16] = "";
+        for (int i = 0; EQUATION_NAMES[type][i] && i < (int)sizeof(upper) - 1; ++i)
+            upper[i] = toupper(EQUATION_NAMES[type][i]);
+        fprintf(f, " | (1 << ET_%s)", upper);
+    }
+    fprintf(f, ",\n");
+    fprintf(f, "        .minSolution = %d, // %s\n", l->minSolution, solution);
+    fprintf(f, "        .roundingFactor = %d,\n", l->roundingFactor);
+    fprintf(f, "    },\n");
+}
+
+int main(int argc, char **argv)
+{
+    Generator g = {
+        .candidateLen = argc > 1 ? atoi(argv[1]) : LEVELGEN_COUNT_DEFAULT,
+        .seed = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 1,
+    };
+    const char *filename = argc > 3 ? argv[3] : "levelgen_output.txt";
+    if (g.candidateLen <= 0)
+    {
+        printf("Usage: levelgen [candidate count] [seed] [output file]\n");
+        return 1;
+    }
+    FILE *f = fopen(filename, "w");
+    if (f == NULL)
+    {
+        printf("ERROR: Could not open %s\n", filename);
+        return 1;
+    }
+    g.candidates = calloc(g.candidateLen, sizeof(Candidate));
+
+    int threadCount = MIN(thread_cpuCount(), g.candidateLen);
+    Thread *threads = calloc(threadCount, sizeof(Thread));
+    double start = thread_time();
+    // the calling thread works too, it also covers threads that failed to start
+    for (int i = 1; i < threadCount; ++i)
+        thread_start(threads + i, worker, &g);
+    worker(&g);
+    for (int i = 1; i < threadCount; ++i)
+        thread_join(threads + i);
+    double seconds = thread_time() - start;
+
+    // the names point into the candidates, fix them up after sorting
+    qsort(g.candidates, g.candidateLen, sizeof(Candidate), compareCandidates);
+    int kept = 0;
+    for (int i = 0; i < g.candidateLen; ++i)
+    {
+        Candidate *c = g.candidates + i;
+        c->def.name = c->name;
+        c->def.health = c->health;
+        if (c->par < 0)
+            continue;
+        writeLevel(f, c);
+        ++kept;
+    }
+    fclose(f);
+
+    printf("%d of %d candidates kept (seed %u), %.2fs on %d thread(s), written to %s\n",
+        kept, g.candidateLen, g.seed, seconds, threadCount, filename);
+    free(threads);
+    free(g.candidates);
+    return 0;
+}
@@ -0,0 +1,110 @@
+#ifndef LEVELS_H
+#define LEVELS_H
+
+#include "sim.h"
+
+static const LevelDef LEVELS[] = {
+    {
+        .name = "Learning to count",
+        .cat = LC_NATURAL,
+        .health = "1,2,3,4,5",
+        .count = 3,
+        .spacing = QUEUE_SPACING_DEFAULT,
+        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB),
+        .minSolution = 5, // [-1] * 2
+        .roundingFactor = 1,
+    },
+    {
+        .name = "Kingmaker",
+        .cat = LC_NATURAL,
+        .health = "5,10,20,40,80",
+        .count = 3,
+        .spacing = QUEUE_SPACING_DEFAULT,
+        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV),
+        .minSolution = 8, // [/2] * 5, [-1] * 3
+        .roundingFactor = 1,
+    },
+    {
+        .name = "Terror from the depths",
+        .cat = LC_INTEGER,
+        .health = "1,-1,2,-2",
+        .count = 5,
+        .spacing = QUEUE_SPACING_DEFAULT,
+        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV),
+        .minSolution = 4, // [/2], [+1], [-1] * 2
+        .roundingFactor = 1,
+    },
+    {
+        .name = "We have to go back",
+        .cat = LC_INTEGER,
+        .health = "-1,-2,-3",
+        .count = 5,
+        .spacing = QUEUE_SPACING_DEFAULT,
+        .towersAllowed = (1 << ET_NONE) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV) | (1 << ET_SQR) | (1 << ET_SQRT),
+        .minSolution = 4, // [/2] * 2, [²], [-1]
+        .roundingFactor = 1,
+    },
+    {
+        .name = "Prime time",
+        .cat = LC_INTEGER,
+        .health = "2,3,5,7,11,13,17,19,23,29,31,37,41,43,47,53,59,61,67,71,73,79,83,89,97,101,103,107,109,113,127,131",
+        .count = 1,
+        .spacing = QUEUE_SPACING_DEFAULT,
+        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV) | (1 << ET_SQR) | (1 << ET_SQRT),
+        .minSolution = 5, // [sqrt] * 4, [-1]
+        .roundingFactor = 1,
+    },
+    {
+        .name = "Glass half full",
+        .cat = LC_RATIONAL,
+        // 4,8,12,16
+        .health = "1.5,3.5,5.5,7.5",
+        .count = 4,
+        .spacing = QUEUE_SPACING_DEFAULT,
+        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV),
+        .minSolution = 8, // [*2], [+1], [/2] * 2, [-1] * 4
+        .roundingFactor = 10,
+    },
+    {
+        .name = "Primer time",
+        .cat = LC_RATIONAL,
+        .health = "2,3,5,7,11,13,17,19,23,29,31,37,41,43,47,53,59,61,67,71,73,79,83,89,97,101,103,107,109,113,127,131",
+        .count = 1,
+        .spacing = QUEUE_SPACING_DEFAULT,
+        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV) | (1 << ET_SQR) | (1 << ET_SQRT),
+        .minSolution = 7, // [sqrt] * 6, [-1]
+        .roundingFactor = 10,
+    },
+    {
+        .name = "Built to scale",
+        .cat = LC_RATIONAL,
+        .health = "1,10,100,1e4,1e5,1e6,1e7,1e8,1e9,1e10",
+        .count = 2,
+        .spacing = QUEUE_SPACING_DEFAULT,
+        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV) | (1 << ET_SQR) | (1 << ET_SQRT) | (1 << ET_LOG_10),
+        .minSolution = 6, // [²], [log_10], [*2], [log_10] * 2, [²]
+        .roundingFactor = 10,
+    },
+    {
+        .name = "Broken Countdown",
+        .cat = LC_RATIONAL,
+        .health = "32,-31,30,-29,28,-27,26,-25,24,-23,22,-21,20,-19,18,-17,16,-15,14,-13,12,-11,10,-9,8,-7,6,-5,4,-3,2,-1",
+        .count = 1,
+        .spacing = QUEUE_SPACING_DEFAULT,
+        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV) | (1 << ET_SQR) | (1 << ET_SQRT) | (1 << ET_LOG_10),
+        .minSolution = 5, // [²], [log_10], [sqrt], [log_10], [²]
+        .roundingFactor = 10,
+    },
+    {
+        .name = "My little brother",
+        .cat = LC_REAL,
+        .health = "1,0.1,0.01",
+        .count = 5,
+        .spacing = QUEUE_SPACING_DEFAULT,
+        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_MULT) | (1 << ET_DIV) | (1 << ET_SQR) | (1 << ET_SQRT) | (1 << ET_LOG_10),
+        .minSolution = 3, // [log_10], [+1] * 2 // [sqr] * 2, [log_10]
+        .roundingFactor = 100,
+    },
+};
+
+#endif // LEVELS_H
@@ -11,28 +11,14 @@
 #include "raygui.h"
 #undef RAYGUI_IMPLEMENTATION
 
-#define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
-#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#include "sim.h"
+#include "sim_thread.h"
+#include "preview.h"
+#include "hint.h"
+#include "replay.h"
+#include "rewind.h"
+#include "levels.h"
 
-typedef enum EquationType 
-{
-    ET_NONE = 0,
-    ET_ADD,
-    ET_SUB,
-    ET_MULT,
-    ET_DIV,
-    ET_SQR,
-    ET_SQRT,
-    ET_LOG_E,
-    ET_LOG_2,
-    ET_LOG_10,
-    ET_ROUND,
-    ET_SIN,
-    ET_COS,
-    ET_TAN,
-
-    ET_EOL
-} EquationType;
 const char* SIGNS[ET_EOL] = {
     "none",
     "+%d",
@@ -50,283 +36,6 @@ const char* SIGNS[ET_EOL] = {
     "tan",
 };
 
-#define HEALTH_DEFAULT 10
-// TODO: Split this more sensibly into "LevelParams" struct or something
-typedef struct Home // also level parameters
-{
-    Rectangle rect;
-    int health;
-    unsigned int allowedTowers; // bit mask of EquationType entries
-    int minTowers;
-    int roundingFactor;
-    int score;
-    int levelIndex;
-} Home;
-
-#define ENEMY_SIZE 20
-typedef struct Enemy
-{
-    Vector2 pos; // center
-    Vector2 speed;
-    float health;
-    bool alive;
-} Enemy;
-
-#define QUEUE_SPACING_DEFAULT 120
-typedef struct EnemyQueue
-{
-    unsigned int spawnFrame;
-    float health;
-} EnemyQueue;
-
-#define SHOT_SIZE 4
-#define SHOT_LIFETIME 12
-typedef struct Shot
-{
-    int tower;
-    int target;
-    EquationType type;
-    int scale;
-    int shotLife;
-} Shot;
-
-#define TOWER_SIZE 50
-#define TOWER_RANGE 150
-#define TOWER_LIST_SIZE 64
-typedef struct Tower
-{
-    Rectangle rect;
-    Vector2 center;
-    EquationType type;
-    int scale;
-    int range;
-    unsigned int lastShot; // in frames
-    unsigned int cooldown; // in frames
-    int enemiesShot[TOWER_LIST_SIZE];
-    unsigned int shotIndex;
-} Tower;
-
-#define SAVED_MSG_LIFETIME 60
-#define SAVED_MOVEY_PER_FRAME -0.2
-typedef struct SavedMessage
-{
-    Vector2 pos;
-    int frames;
-} SavedMessage;
-
-typedef struct GameState
-{
-    Home home;
-
-    Tower *towers;
-    unsigned int towerLen;
-
-    Enemy *enemies;
-    unsigned int enemiesLen;
-
-    EnemyQueue *queue; // needs to be ordered by spawnFrame (lowest first)
-    unsigned int queueHead;
-    unsigned int queueTail;
-
-    Shot *shots;
-    unsigned int shotHead;
-    unsigned int shotTail;
-
-    SavedMessage *msg;
-    unsigned int msgIndex;
-} GameState;
-
-#define MAX_TOWERS 32
-#define MAX_ENEMIES 1024
-#define QUEUE_SIZE 64
-#define SAVED_MSGS_MAX 32
-#define MAX_SIMUL_SHOTS MAX_TOWERS
-void state_init(GameState *s)
-{
-    s->home = (Home){
-        .rect = {50, 200, TOWER_SIZE, TOWER_SIZE},
-        .health = 10,
-        .allowedTowers = -1, // all by default
-    };
-
-    s->towers = calloc(MAX_TOWERS, sizeof(s->towers[0]));
-    s->towerLen = 0;
-
-    s->enemies = calloc(MAX_ENEMIES, sizeof(s->enemies[0]));
-    s->enemiesLen = 0;
-
-    s->queue = calloc(QUEUE_SIZE, sizeof(s->queue[0]));
-    s->queueHead = 0;
-    s->queueTail = 0;
-
-    // rolling buffer, we do not check for overwrites, so this has to be big enough
-    // Equal to max towers, because every tower can only shoot once simultaniously
-    s->shots = calloc(MAX_SIMUL_SHOTS, sizeof(s->shots[0]));
-    s->shotHead = 0;
-    s->shotTail = 0;
-
-    s->msg = calloc(SAVED_MSGS_MAX, sizeof(SavedMessage));
-    s->msgIndex = 0;
-}
-
-void state_free(GameState *s)
-{
-    free(s->towers);
-    free(s->enemies);
-    free(s->queue);
-    free(s->shots);
-    free(s->msg);
-}
-
-void state_reset(GameState *s)
-{
-    s->towerLen = 0;
-    s->home.health = HEALTH_DEFAULT;
-    s->home.score = 0;
-    s->enemiesLen = 0;
-    s->queueHead = s->queueTail = 0;
-    s->shotHead = s->shotTail = 0;
-    s->msgIndex = 0;
-}
-
-void state_addTower(GameState *s, int tileX, int tileY, int type, int scale)
-{
-    s->towers[s->towerLen++] = (Tower){
-        .rect = {tileX * TOWER_SIZE, tileY * TOWER_SIZE, TOWER_SIZE, TOWER_SIZE},
-        .center = {(tileX + 0.5) * TOWER_SIZE, (tileY + 0.5) * TOWER_SIZE},
-        .type = type,
-        .scale = scale,
-        .range = TOWER_RANGE,
-        .cooldown = 60,
-    };
-}
-
-// returns true if all entries were added
-bool state_addQueueFromString(GameState *s, unsigned int startFrame, const char *queue, unsigned int count, unsigned int spacing)
-{
-    unsigned int spawnFrame;
-    if (s->queueHead == s->queueTail) // queue is empty -> spawn immediately
-        spawnFrame = startFrame;
-    else
-        spawnFrame = s->queue[(s->queueHead - 1) % QUEUE_SIZE].spawnFrame + spacing;
-    while (count > 0)
-    {
-        char *buffer = strdup(queue);
-        char *prev = buffer;
-        char *pos = strtok(prev, ",;");
-        while (pos != NULL)
-        {
-            bool queueIsFull = (s->queueHead - s->queueTail >= QUEUE_SIZE);
-            if (queueIsFull)
-                return false;
-
-            float value = atof(pos);
-            if (value == 0 || !isfinite(value))
-                continue;
-
-            s->queue[s->queueHead % QUEUE_SIZE] = (EnemyQueue){
-                .spawnFrame = spawnFrame,
-                .health = atof(pos),
-            };
-            ++s->queueHead;
-            spawnFrame += spacing;
-            prev = pos;
-            pos = strtok(NULL, ",;");
-        }
-
-        free(buffer);
-        --count;
-    }
-
-    return true;
-}
-
-bool canTarget(EquationType tower, float health)
-{
-    switch (tower)
-    {
-        case ET_ADD:
-        case ET_SUB:
-        case ET_MULT:
-        case ET_DIV:
-        case ET_SQR:
-        case ET_ROUND:
-        case ET_SIN:
-        case ET_COS:
-            return true;
-        case ET_SQRT:
-        case ET_LOG_E:
-        case ET_LOG_2:
-        case ET_LOG_10:
-            return health > 0;
-        case ET_TAN:
-            if (fabsf(health - (int)health) > FLT_EPSILON)
-                return true;
-            return ((int)health % 90 != 0) || ((int)health % 180 == 0);
-        default:
-            printf("ERROR: Type of tower unknown: %d\n", tower);
-            assert(false); // always assert
-    }
-    return false;
-}
-
-typedef enum TakeHealthResult
-{
-    TH_DEAD,
-    TH_ALIVE,
-    TH_SAVED_BY_ROUNDING,
-} TakeHealthResult;
-
-// takes health and returns state of enemy
-TakeHealthResult takeHealth(Enemy *e, Tower *t, int rounding)
-{
-    switch (t->type)
-    {
-        case ET_ADD: e->health += t->scale; break;
-        case ET_SUB: e->health -= t->scale; break;
-        case ET_MULT: e->health *= t->scale; break;
-        case ET_DIV: e->health /= t->scale; break;
-        case ET_SQR: e->health = e->health * e->health; break;
-        case ET_SQRT: e->health = sqrtf(e->health); break;
-        case ET_LOG_E: e->health = logf(e->health); break;
-        case ET_LOG_2: e->health = log2f(e->health); break;
-        case ET_LOG_10: e->health = log10f(e->health); break;
-        case ET_ROUND: e->health = roundf(e->health * powf(10, t->scale - 1)) / powf(10, t->scale - 1); break;
-        case ET_SIN: e->health = sinf(DEG2RAD * e->health); break;
-        case ET_COS: e->health = cosf(DEG2RAD * e->health); break;
-        case ET_TAN: e->health = tanf(DEG2RAD * e->health); break;
-        default:
-            printf("ERROR: Type of tower unknown: %d\n", t->type);
-            assert(false);
-    }
-    float healthNotRounded = 0;
-    if (rounding > 0)
-    {
-        healthNotRounded = (float)(int)(e->health * rounding) / rounding;
-        e->health = roundf(e->health * rounding) / rounding;
-    }
-
-    if (fabs(e->health) < FLT_EPSILON)
-    {
-        return TH_DEAD;
-    }
-    if (rounding > 0 && fabs(healthNotRounded) < FLT_EPSILON)
-    {
-        return TH_SAVED_BY_ROUNDING;
-    }
-    return TH_ALIVE;
-}
-
-bool hasAlreadyTargeted(int *list, int len, int index)
-{
-    for (int i = 0; i < len; ++i)
-    {
-        if (list[i] == index)
-            return true;
-    }
-    return false;
-}
-
 #define FONT_SIZE 20
 #define MIN_FONT_SIZE 10
 
@@ -349,6 +58,42 @@ typedef enum EditBox
     EB_SPACING,
 } EditBox;
 
+#define TURBO_BUDGET_DEFAULT 12 // ms per rendered frame
+#define TURBO_BUDGET_MAX 50
+typedef struct Turbo
+{
+    int budgetMs;
+    // achieved sim frames per second, measured over ~0.5s
+    double rateStart;
+    unsigned int rateFrames;
+    float rate;
+} Turbo;
+
+// predicted outcome of the tower under the mouse, computed by the preview thread
+typedef struct Ghost
+{
+    SimCommand tower; // candidate, CMD_NONE if there is none
+    // what the last request was made for, any change asks again
+    unsigned int towerLen;
+    unsigned int queueHead;
+    unsigned int queueTail;
+    int roundingFactor;
+    unsigned int frame;
+    PreviewResult result;
+} Ghost;
+
+// Rewind: LEFT and RIGHT step through the snapshots in rewindBuffer and pause. The
+// simulation thread is stopped meanwhile, the main thread's state is shown. Playing on
+// continues from the snapshot shown, the snapshots and the recorded input after it
+// are dropped so the replay stays in step.
+typedef struct Scrub
+{
+    bool active;
+    int index; // snapshot shown
+    bool stoppedThread; // restart the simulation thread when done
+    unsigned int commandBase; // replay.commands when the simulation thread started
+} Scrub;
+
 typedef enum Scene
 {
     SC_MENU,
@@ -359,135 +104,10 @@ typedef enum Scene
     SC_EXIT,
 } Scene;
 
-typedef enum LevelCat
-{
-    LC_NATURAL,
-    LC_INTEGER,
-    LC_RATIONAL,
-    LC_REAL,
-
-    LC_EOL
-} LevelCat;
 const char* CATEGORY[LC_EOL] = {
     "Natural Numbers N", "Integers Z", "Rational Numbers Q (0.1 precision)", "Real Numbers R (0.01 precision)",
 };
 
-typedef struct LevelDef
-{
-    const char *name;
-    LevelCat cat;
-    const char *health;
-    int count;
-    int spacing;
-    unsigned int towersAllowed;
-    int minSolution;
-    int roundingFactor;
-} LevelDef;
-
-const LevelDef LEVELS[] = {
-    {
-        .name = "Learning to count",
-        .cat = LC_NATURAL,
-        .health = "1,2,3,4,5",
-        .count = 3,
-        .spacing = QUEUE_SPACING_DEFAULT,
-        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB),
-        .minSolution = 5, // [-1] * 2
-        .roundingFactor = 1,
-    },
-    {
-        .name = "Kingmaker",
-        .cat = LC_NATURAL,
-        .health = "5,10,20,40,80",
-        .count = 3,
-        .spacing = QUEUE_SPACING_DEFAULT,
-        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV),
-        .minSolution = 8, // [/2] * 5, [-1] * 3
-        .roundingFactor = 1,
-    },
-    {
-        .name = "Terror from the depths",
-        .cat = LC_INTEGER,
-        .health = "1,-1,2,-2",
-        .count = 5,
-        .spacing = QUEUE_SPACING_DEFAULT,
-        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV),
-        .minSolution = 4, // [/2], [+1], [-1] * 2
-        .roundingFactor = 1,
-    },
-    {
-        .name = "We have to go back",
-        .cat = LC_INTEGER,
-        .health = "-1,-2,-3",
-        .count = 5,
-        .spacing = QUEUE_SPACING_DEFAULT,
-        .towersAllowed = (1 << ET_NONE) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV) | (1 << ET_SQR) | (1 << ET_SQRT),
-        .minSolution = 5, // [²], [sqrt], [-1] * 3
-        .roundingFactor = 1,
-    },
-    {
-        .name = "Prime time",
-        .cat = LC_INTEGER,
-        .health = "2,3,5,7,11,13,17,19,23,29,31,37,41,43,47,53,59,61,67,71,73,79,83,89,97,101,103,107,109,113,127,131",
-        .count = 1,
-        .spacing = QUEUE_SPACING_DEFAULT,
-        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV) | (1 << ET_SQR) | (1 << ET_SQRT),
-        .minSolution = 5, // [sqrt] * 4, [-1]
-        .roundingFactor = 1,
-    },
-    {
-        .name = "Glass half full",
-        .cat = LC_RATIONAL,
-        // 4,8,12,16
-        .health = "1.5,3.5,5.5,7.5",
-        .count = 4,
-        .spacing = QUEUE_SPACING_DEFAULT,
-        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV),
-        .minSolution = 8, // [*2], [+1], [/2] * 2, [-1] * 4
-        .roundingFactor = 10,
-    },
-    {
-        .name = "Primer time",
-        .cat = LC_RATIONAL,
-        .health = "2,3,5,7,11,13,17,19,23,29,31,37,41,43,47,53,59,61,67,71,73,79,83,89,97,101,103,107,109,113,127,131",
-        .count = 1,
-        .spacing = QUEUE_SPACING_DEFAULT,
-        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV) | (1 << ET_SQR) | (1 << ET_SQRT),
-        .minSolution = 7, // [sqrt] * 6, [-1]
-        .roundingFactor = 10,
-    },
-    {
-        .name = "Built to scale",
-        .cat = LC_RATIONAL,
-        .health = "1,10,100,1e4,1e5,1e6,1e7,1e8,1e9,1e10",
-        .count = 2,
-        .spacing = QUEUE_SPACING_DEFAULT,
-        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV) | (1 << ET_SQR) | (1 << ET_SQRT) | (1 << ET_LOG_10),
-        .minSolution = 8, // [log_10] * 2, [+1], [sqrt] * 4, [-1]
-        .roundingFactor = 10,
-    },
-    {
-        .name = "Broken Countdown",
-        .cat = LC_RATIONAL,
-        .health = "32,-31,30,-29,28,-27,26,-25,24,-23,22,-21,20,-19,18,-17,16,-15,14,-13,12,-11,10,-9,8,-7,6,-5,4,-3,2,-1",
-        .count = 1,
-        .spacing = QUEUE_SPACING_DEFAULT,
-        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_SUB) | (1 << ET_MULT) | (1 << ET_DIV) | (1 << ET_SQR) | (1 << ET_SQRT) | (1 << ET_LOG_10),
-        .minSolution = 9, // [²], [log_10], [+1], [sqrt]*5, [-1]
-        .roundingFactor = 10,
-    },
-    {
-        .name = "My little brother",
-        .cat = LC_REAL,
-        .health = "1,0.1,0.01",
-        .count = 5,
-        .spacing = QUEUE_SPACING_DEFAULT,
-        .towersAllowed = (1 << ET_NONE) | (1 << ET_ADD) | (1 << ET_MULT) | (1 << ET_DIV) | (1 << ET_SQR) | (1 << ET_SQRT) | (1 << ET_LOG_10),
-        .minSolution = 3, // [log_10], [+1] * 2 // [sqr] * 2, [log_10]
-        .roundingFactor = 100,
-    },
-};
-
 typedef struct Savegame
 {
     int progress;
@@ -495,6 +115,7 @@ typedef struct Savegame
 } Savegame;
 
 #define SAVE_FILE "save.me"
+#define REPLAY_FILE "replay.mtdr" // the last level or playground session
 bool load_progress(Savegame *data, const char *filename)
 {
     FILE *f = fopen(filename, "rb");
@@ -527,12 +148,20 @@ bool save_progress(Savegame *data, const char *filename)
     return true;
 }
 
-const int screenWidth = 800;
-const int screenHeight = 450;
+const int screenWidth = FIELD_WIDTH;
+const int screenHeight = FIELD_HEIGHT;
 Scene scene;
 Savegame save;
 RenderTexture2D screen;
 float scale = 1.0f;
+Turbo turbo = { .budgetMs = TURBO_BUDGET_DEFAULT };
+bool threadedSim = false; // --threaded: run the simulation on its own thread
+SimThread simThread;
+bool ghostPreview = false; // the preview thread is running
+Preview preview;
+Replay replay; // recording of the current scene
+Rewind rewindBuffer; // of the current scene, rewind() is taken by stdio
+Scrub scrub;
 
 void menu(void);
 void tutorial(void);
@@ -541,10 +170,16 @@ void level(GameState *state);
 void playground(GameState *state);
 
 void level_logic(GameState *state, unsigned int frame);
-void level_draw(GameState *state);
+void level_draw(const GameState *state);
 
-int main(void)
+int main(int argc, char **argv)
 {
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--threaded") == 0)
+            threadedSim = true;
+    }
+
     SetConfigFlags(FLAG_WINDOW_RESIZABLE | FLAG_VSYNC_HINT | FLAG_MSAA_4X_HINT);
     InitWindow(screenWidth, screenHeight, "A puzzling tower defense game for beautiful math nerds.");
     SetWindowMinSize(screenWidth, screenHeight);
@@ -561,6 +196,18 @@ int main(void)
 
     GameState state;
     state_init(&state);
+    HealthCache healthCache;
+    cache_init(&healthCache, HEALTH_CACHE_BITS_DEFAULT);
+    state.healthCache = &healthCache;
+    replay_init(&replay, REPLAY_SIZE_DEFAULT);
+    rewind_init(&rewindBuffer, REWIND_SIZE_DEFAULT, REWIND_INTERVAL_DEFAULT);
+    if (threadedSim)
+    {
+        simthread_init(&simThread);
+        simThread.replay = &replay;
+    }
+    preview_init(&preview);
+    ghostPreview = preview_start(&preview);
 
     scene = SC_MENU;
     bool shouldClose = false;
@@ -599,7 +246,13 @@ int main(void)
         }
     }
 
+    if (threadedSim)
+        simthread_free(&simThread);
+    replay_free(&replay);
+    rewind_free(&rewindBuffer);
+    preview_free(&preview);
     state_free(&state);
+    cache_free(&healthCache);
 
     UnloadRenderTexture(screen);
 
@@ -730,15 +383,6 @@ void menu(void)
     }
 }
 
-void state_loadFromLevelDef(GameState *state, LevelDef l, int index)
-{
-    state_addQueueFromString(state, 0, l.health, l.count, l.spacing);
-    state->home.allowedTowers = l.towersAllowed;
-    state->home.minTowers = l.minSolution;
-    state->home.roundingFactor = l.roundingFactor;
-    state->home.levelIndex = index;
-}
-
 void tutorial(void)
 {
     bool sceneChange = false;
@@ -776,7 +420,7 @@ void tutorial(void)
         yPos += FONT_SIZE + spacing;
         DrawText("- Towers cannot be sold/deleted, but pressing R will restart the level.", 16, yPos, FONT_SIZE, BLACK);
         yPos += FONT_SIZE + spacing;
-        DrawText("- Space pauses.", 16, yPos, FONT_SIZE, BLACK);
+        DrawText("- Space pauses, Left/Right rewind, H shows a hint for the next tower.", 16, yPos, FONT_SIZE, BLACK);
         yPos += FONT_SIZE + spacing;
         DrawText("- Gold stars are awarded for:", 16, yPos, FONT_SIZE, BLACK);
         yPos += FONT_SIZE + spacing;
@@ -894,6 +538,246 @@ void level_select(GameState *state)
     }
 }
 
+void turbo_measure(double now)
+{
+    if (now - turbo.rateStart >= 0.5)
+    {
+        turbo.rate = turbo.rateFrames / (now - turbo.rateStart);
+        turbo.rateFrames = 0;
+        turbo.rateStart = now;
+    }
+}
+
+void scrub_resume(void);
+
+// applies cmd directly or hands it to the simulation thread, both record it
+void sim_send(GameState *state, unsigned int *frame, bool threaded, const SimCommand *cmd)
+{
+    if (threaded)
+    {
+        simthread_send(&simThread, cmd);
+        return;
+    }
+    // input while rewound plays on from there
+    scrub_resume();
+    unsigned int before = *frame;
+    bool accepted = sim_applyCommand(state, frame, cmd);
+    replay_recordCommand(&replay, before, cmd, accepted);
+}
+
+// writes the recording of the scene that just ended
+void replay_finish(unsigned int frame)
+{
+    replay_end(&replay, frame);
+    if (!replay_save(&replay, REPLAY_FILE))
+        printf("WARNING: Could not write %s\n", REPLAY_FILE);
+}
+
+// starts rewinding for a scene, after replay_begin and simthread_start
+void scrub_begin(void)
+{
+    rewind_clear(&rewindBuffer);
+    scrub = (Scrub){ .commandBase = replay.commands };
+}
+
+// LEFT/RIGHT step to the snapshot before/after the one shown, returns true if state
+// changed. The first step stops the simulation thread and adds the state as it is now
+// as the newest snapshot.
+bool scrub_step(GameState *state, unsigned int *frame, bool *threaded)
+{
+    int step = (IsKeyPressed(KEY_RIGHT) || IsKeyPressedRepeat(KEY_RIGHT))
+        - (IsKeyPressed(KEY_LEFT) || IsKeyPressedRepeat(KEY_LEFT));
+    if (step == 0)
+        return false;
+
+    if (!scrub.active)
+    {
+        if (*threaded)
+        {
+            simthread_stop(&simThread, state, frame);
+            *threaded = false;
+            scrub.stoppedThread = true;
+        }
+        rewind_capture(&rewindBuffer, state, *frame, replay.commands);
+        scrub.active = true;
+        scrub.index = rewindBuffer.count - 1;
+    }
+    scrub.index += step;
+    if (scrub.index < 0)
+        scrub.index = 0;
+    if (scrub.index > (int)rewindBuffer.count - 1)
+        scrub.index = rewindBuffer.count - 1;
+    rewind_restore(&rewindBuffer, scrub.index, state);
+    *frame = rewind_snapshot(&rewindBuffer, scrub.index)->frame;
+    return true;
+}
+
+// drops everything after the snapshot shown, play continues from it
+void scrub_resume(void)
+{
+    if (!scrub.active)
+        return;
+    rewind_truncate(&rewindBuffer, scrub.index);
+    replay_truncate(&replay, rewind_snapshot(&rewindBuffer, scrub.index)->tag);
+    scrub.active = false;
+}
+
+// Once per frame before the logic: resumes once unpaused and restarts the simulation
+// thread if scrubbing stopped it. Returns whether the simulation is threaded now.
+bool scrub_update(GameState *state, unsigned int frame, bool threaded, bool paused)
+{
+    if (scrub.active && !paused)
+        scrub_resume();
+    if (scrub.active || !scrub.stoppedThread)
+        return threaded;
+    scrub.stoppedThread = false;
+    scrub.commandBase = replay.commands;
+    return simthread_start(&simThread, state, frame);
+}
+
+void scrub_draw(int y)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "REWIND %d / %u", scrub.index + 1, rewindBuffer.count);
+    int textW = MeasureText(text, FONT_SIZE * 2);
+    DrawText(text, (screenWidth - textW) / 2, y, FONT_SIZE * 2, BLACK);
+}
+
+// runs the simulation until the time budget of this frame is used up
+void turbo_run(GameState *state, unsigned int *frame, bool stopWhenOver)
+{
+    if (IsKeyPressed(KEY_PAGE_UP) && turbo.budgetMs < TURBO_BUDGET_MAX)
+        ++turbo.budgetMs;
+    if (IsKeyPressed(KEY_PAGE_DOWN) && turbo.budgetMs > 1)
+        --turbo.budgetMs;
+
+    double start = GetTime();
+    double now = start;
+    do
+    {
+        if (stopWhenOver && state_isOver(state))
+            break;
+
+        unsigned int frames = level_advance(state, *frame, TURBO_MAX_SKIP);
+        *frame += frames;
+        turbo.rateFrames += frames;
+        now = GetTime();
+    } while ((now - start) * 1000 < turbo.budgetMs);
+
+    turbo_measure(now);
+}
+
+void turbo_draw(int x, int y)
+{
+    char text[64] = "";
+    snprintf(text, sizeof(text), "Turbo %d ms: %.0f frames/s", turbo.budgetMs, turbo.rate);
+    DrawText(text, x, y, FONT_SIZE / 2, BLACK);
+}
+
+// asks the preview thread about candidate (NULL: nothing to preview) when it or the state changed
+void ghost_update(Ghost *g, const GameState *view, unsigned int frame, const SimCommand *candidate)
+{
+    if (!ghostPreview)
+        return;
+
+    SimCommand none = { .type = CMD_NONE };
+    if (candidate == NULL)
+        candidate = &none;
+    bool changed = candidate->type != g->tower.type
+        || candidate->tileX != g->tower.tileX
+        || candidate->tileY != g->tower.tileY
+        || candidate->tower != g->tower.tower
+        || candidate->scale != g->tower.scale;
+    if (candidate->type != CMD_NONE)
+    {
+        changed |= view->towerLen != g->towerLen
+            || view->queueHead != g->queueHead
+            || view->queueTail != g->queueTail
+            || view->home.roundingFactor != g->roundingFactor
+            || (int)(frame - g->frame) < 0; // restarted
+    }
+    if (!changed)
+        return;
+
+    bool sent;
+    if (candidate->type == CMD_NONE)
+        sent = preview_request(&preview, NULL, 0, NULL);
+    else
+        sent = preview_request(&preview, view, frame, candidate);
+    if (!sent)
+        return; // busy, try again next frame
+
+    g->tower = *candidate;
+    g->towerLen = view->towerLen;
+    g->queueHead = view->queueHead;
+    g->queueTail = view->queueTail;
+    g->roundingFactor = view->home.roundingFactor;
+    g->frame = frame;
+}
+
+Color ghostColor(int outcome)
+{
+    switch (outcome)
+    {
+        case EO_DIES: return DARKGREEN;
+        case EO_HOME: return RED;
+        default: return DARKGRAY;
+    }
+}
+
+// Marks enemies by predicted outcome and shows a summary above the candidate tile.
+// Keeps showing the previous result until the one for the latest request arrives.
+void ghost_draw(Ghost *g, const GameState *view, bool showScore)
+{
+    if (!ghostPreview || g->tower.type == CMD_NONE)
+        return;
+    bool latest = preview_poll(&preview, &g->result);
+    if (g->result.generation == 0 || !g->result.valid)
+        return;
+
+    for (int i = 0; i < view->enemiesLen; ++i)
+    {
+        int outcome = preview_enemyOutcome(&g->result, view->enemies.handle[i]);
+        if (outcome >= 0)
+            DrawCircleLinesV((Vector2){ view->enemies.x[i], view->enemies.y[i] }, ENEMY_SIZE + 2, ghostColor(outcome));
+    }
+
+    char text[64] = "";
+    int len = snprintf(text, sizeof(text), "%d die, %d reach home", g->result.dies, g->result.reachesHome);
+    if (showScore && g->result.score > 0)
+        len += snprintf(text + len, sizeof(text) - len, ", score %d / 3", g->result.score);
+    else if (showScore)
+        len += snprintf(text + len, sizeof(text) - len, ", lost");
+    if (!latest)
+        snprintf(text + len, sizeof(text) - len, " ...");
+    DrawText(text, g->tower.tileX * TOWER_SIZE, g->tower.tileY * TOWER_SIZE - FONT_SIZE / 2 - 2, FONT_SIZE / 2, BLACK);
+}
+
+// Outlines the suggested tile, the text goes above the tower buttons. Keeps showing
+// the previous suggestion (marked with ...) while the search for new inputs runs.
+void hint_draw(const Hint *h, const GameState *view)
+{
+    char text[96] = "";
+    if (h->status == HINT_RUNNING)
+        snprintf(text, sizeof(text), "Hint: searching...");
+    else if (h->status == HINT_NONE)
+        snprintf(text, sizeof(text), "Hint: no win with up to %d more towers, press R to restart", HINT_MAX_INSERT);
+    else if (h->tower.type == CMD_NONE)
+        snprintf(text, sizeof(text), "Hint: the placed towers are enough");
+    else
+    {
+        Solution next = { .ops = { { h->tower.tower, h->tower.scale } }, .len = 1 };
+        char op[32] = "";
+        solver_describe(&next, op, sizeof(op));
+        snprintf(text, sizeof(text), "Hint: %s here, %d to go for %d towers (par %d)",
+            op, h->towersLeft, view->towerLen + h->towersLeft, view->home.minTowers);
+        DrawRectangleLinesEx((Rectangle){ h->tower.tileX * TOWER_SIZE, h->tower.tileY * TOWER_SIZE, TOWER_SIZE, TOWER_SIZE }, 3, GOLD);
+    }
+    if (h->stale)
+        strncat(text, " ...", sizeof(text) - strlen(text) - 1);
+    DrawText(text, 4, screenHeight - BUTTON_SIZE - GUI_SPACING * 2 - FONT_SIZE / 2, FONT_SIZE / 2, BLACK);
+}
+
 void level(GameState *state)
 {
     assert(state);
@@ -907,9 +791,7 @@ void level(GameState *state)
 
     unsigned int frame = -300; // test rollover robustness
 
-    Rectangle path = {100, 200, screenWidth - 100, TOWER_SIZE};
-    Rectangle guiArea = {0, screenHeight - TOWER_SIZE - 1, screenWidth, TOWER_SIZE + 1};
-    Rectangle guiAreaTop = {0, 0, screenWidth, TOWER_SIZE + 1};
+    Rectangle path = {(HOME_TILE_X + 1) * TOWER_SIZE, PATH_TILE_Y * TOWER_SIZE, screenWidth - (HOME_TILE_X + 1) * TOWER_SIZE, TOWER_SIZE};
 
     int currentType = ET_NONE;
     bool paused = false;
@@ -918,9 +800,25 @@ void level(GameState *state)
     int aliveCount = 0;
     bool gameEnded = false;
 
-    EnemyQueue *queueBackup = calloc(QUEUE_SIZE, sizeof(queueBackup[0]));
-    memcpy(queueBackup, state->queue, QUEUE_SIZE * sizeof(queueBackup[0]));
-    unsigned int queueBackupHead = state->queueHead;
+    int score = 0;
+    // results of earlier scenes are not shown
+    Ghost ghost = { .result.generation = atomic_get(&preview.requestGeneration) };
+    Hint hint;
+    hint_init(&hint);
+    bool showHint = false;
+
+    replay_begin(&replay, state->home.levelIndex, state, frame);
+    bool threaded = threadedSim && simthread_start(&simThread, state, frame);
+    if (threaded)
+        atomic_set(&simThread.stopWhenOver, true);
+    scrub_begin();
+    const GameState *view = state;
+    // restarting reloads the level
+    SimCommand restart = {
+        .type = CMD_LOAD_LEVEL,
+        .level = LEVELS[state->home.levelIndex],
+        .levelIndex = state->home.levelIndex,
+    };
 
     // Main game loop
     while (!WindowShouldClose() && !sceneChange)
@@ -928,6 +826,23 @@ void level(GameState *state)
         if (IsWindowResized())
             UpdateGlobalScaling();
 
+        bool upToDate = true; // the state shows the effect of all input so far
+        unsigned int commands; // recorded before view, tags the rewind snapshots
+        if (threaded)
+        {
+            const SimSnapshot *snap = simthread_acquire(&simThread);
+            view = &snap->state;
+            frame = snap->frame;
+            upToDate = (snap->commandsApplied == simThread.commandHead);
+            commands = scrub.commandBase + snap->commandsApplied;
+        }
+        else
+        {
+            commands = replay.commands;
+        }
+        if (!scrub.active)
+            rewind_update(&rewindBuffer, view, frame, commands);
+
         // ------------------ Input ------------------
         if (IsKeyPressed(KEY_ESCAPE))
         {
@@ -937,81 +852,103 @@ void level(GameState *state)
         }
         if (IsKeyPressed(KEY_R))
         {
-            state_reset(state);
-            memcpy(state->queue, queueBackup, QUEUE_SIZE * sizeof(queueBackup[0]));
-            state->queueHead = queueBackupHead;
-            frame = 0;
+            sim_send(state, &frame, threaded, &restart);
         }
         if (IsKeyPressed(KEY_SPACE))
         {
             paused = !paused;
         }
+        if (IsKeyPressed(KEY_H))
+        {
+            showHint = !showHint;
+        }
+        if (scrub_step(state, &frame, &threaded))
+        {
+            view = state;
+            paused = true;
+            gameEnded = false;
+        }
 
-        bool canPlaceTower = !gameEnded;
-
-        canPlaceTower &= !CheckCollisionPointRec(GetMousePosition(), path);
-        canPlaceTower &= !CheckCollisionPointRec(GetMousePosition(), state->home.rect);
-        canPlaceTower &= !CheckCollisionPointRec(GetMousePosition(), guiArea);
-        canPlaceTower &= !CheckCollisionPointRec(GetMousePosition(), guiAreaTop);
+        int tileX = GetMouseX() / TOWER_SIZE;
+        int tileY = GetMouseY() / TOWER_SIZE;
+        // the same rule is checked by verify and validate
+        bool canPlaceTower = !gameEnded && sim_canPlaceTile(tileX, tileY);
 
         if (canPlaceTower)
         {
-            for (int i = 0; i < state->towerLen; ++i) {
-                canPlaceTower &= !CheckCollisionPointRec(GetMousePosition(), state->towers[i].rect);
+            for (int i = 0; i < view->towerLen; ++i) {
+                canPlaceTower &= !CheckCollisionPointRec(GetMousePosition(), view->towers[i].rect);
             }
         }
-
-        int tileX = GetMouseX() / TOWER_SIZE;
-        int tileY = GetMouseY() / TOWER_SIZE;
-        if (IsMouseButtonPressed(0) && state->towerLen < MAX_TOWERS && canPlaceTower && currentType != ET_NONE)
+        if (IsMouseButtonPressed(0) && view->towerLen < MAX_TOWERS && canPlaceTower && currentType != ET_NONE)
         {
-            int scale = 1;
-            if (currentType == ET_MULT || currentType == ET_DIV)
-                scale = 2;
-            state_addTower(state, tileX, tileY, currentType, scale);
+            int scale = defaultTowerScale(currentType);
+            SimCommand cmd = {
+                .type = CMD_ADD_TOWER,
+                .tileX = tileX,
+                .tileY = tileY,
+                .tower = currentType,
+                .scale = scale,
+            };
+            sim_send(state, &frame, threaded, &cmd);
         }
 
+        // predicted outcome of the tower under the mouse
+        SimCommand candidate = {
+            .type = CMD_ADD_TOWER,
+            .tileX = tileX,
+            .tileY = tileY,
+            .tower = currentType,
+            .scale = defaultTowerScale(currentType),
+        };
+        bool hovering = canPlaceTower && currentType != ET_NONE && view->towerLen < MAX_TOWERS;
+        ghost_update(&ghost, view, frame, hovering ? &candidate : NULL);
+
+        // searches in slices, a few ms per frame
+        if (showHint && !gameEnded)
+            hint_update(&hint, view, HINT_BUDGET_DEFAULT);
+
         // ------------------ Logic ------------------
-        if (!paused)
+        threaded = scrub_update(state, frame, threaded, paused);
+        if (!threaded && !scrub.active)
+            replay_recordSpeed(&replay, frame, paused ? REPLAY_PAUSED : speedLevel);
+        if (threaded)
         {
-            for (int i = 0; i < speedLevel; ++i)
-            {
-                level_logic(state, frame);
-
-                ++frame;
-            }
-            aliveCount = 0;
-            for (int i = state->enemiesLen-1; i >= 0; --i)
+            atomic_set(&simThread.paused, paused);
+            atomic_set(&simThread.speed, speedLevel);
+            turbo.rateFrames += atomic_swap(&simThread.framesSimulated, 0);
+            turbo_measure(GetTime());
+        }
+        else if (!paused)
+        {
+            if (speedLevel == SPEED_TURBO)
+                turbo_run(state, &frame, true);
+            for (int i = 0; i < speedLevel; )
             {
-                if (!state->enemies[i].alive)
-                    continue;
+                // skips ahead over frames where nothing but movement happens
+                unsigned int frames = level_advance(state, frame, speedLevel - i);
 
-                ++aliveCount;
+                frame += frames;
+                i += frames;
             }
+        }
+        if (!paused && upToDate)
+        {
+            aliveCount = view->enemiesLen; // dead enemies are removed by level_logic
 
-            if (state->queueHead == state->queueTail && aliveCount == 0)
+            if (view->queueHead == view->queueTail && aliveCount == 0)
             {
                 // win
                 gameEnded = true;
-                if (state->home.health == HEALTH_DEFAULT)
-                {
-                    if (state->towerLen < state->home.minTowers)
-                        state->home.score = 4;
-                    else if (state->towerLen == state->home.minTowers)
-                        state->home.score = 3;
-                    else
-                        state->home.score = 2;
-                }
-                else
-                    state->home.score = 1;
-                
-                if (state->home.levelIndex >= save.progress)
-                    save.progress = state->home.levelIndex + 1;
-                if (save.scores[state->home.levelIndex] < state->home.score)
-                    save.scores[state->home.levelIndex] = state->home.score;
+                score = state_score(view);
+
+                if (view->home.levelIndex >= save.progress)
+                    save.progress = view->home.levelIndex + 1;
+                if (save.scores[view->home.levelIndex] < score)
+                    save.scores[view->home.levelIndex] = score;
                 save_progress(&save, SAVE_FILE);
             }
-            else if (state->home.health <= 0)
+            else if (view->home.health <= 0)
             {
                 // lose
                 gameEnded = true;
@@ -1037,18 +974,24 @@ void level(GameState *state)
             }
         }
 
-        level_draw(state);
+        level_draw(view);
+        ghost_draw(&ghost, view, true);
+        if (showHint && !gameEnded)
+            hint_draw(&hint, view);
 
         // queue preview
         int ePosX = 60;
         const int ePosY = 4 + ENEMY_SIZE;
         char text[64] = "";
         DrawText("Queue:", 4, ePosY - 4, 10, BLACK);
-        for (int i = state->queueTail; i < state->queueHead; ++i)
+        for (int i = view->queueTail; i < view->queueHead; ++i)
         {
-            EnemyQueue *q = state->queue + i;
+            EnemyQueue *q = view->queue + i;
             
             DrawCircle(ePosX, ePosY, ENEMY_SIZE, enemyColor(q->health));
+            int outcome = preview_queuedOutcome(&ghost.result, i);
+            if (ghost.tower.type != CMD_NONE && ghost.result.valid && outcome >= 0)
+                DrawCircleLines(ePosX, ePosY, ENEMY_SIZE + 2, ghostColor(outcome));
             snprintf(text, sizeof(text), "%.3g", q->health);
             int fontSize = FONT_SIZE;
             int textWidthPixels = MeasureText(text, fontSize);
@@ -1074,7 +1017,7 @@ void level(GameState *state)
         if (gameEnded)
             GuiLock();
 
-        int btnPos = screenWidth - (GUI_SPACING + 24) * 4;
+        int btnPos = screenWidth - (GUI_SPACING + 24) * 5;
         bool speedBtnActive = paused;
         GuiToggle((Rectangle){btnPos, 4, 24, 24}, GuiIconText(ICON_PLAYER_PAUSE, NULL), &speedBtnActive);
         paused = speedBtnActive;
@@ -1087,7 +1030,7 @@ void level(GameState *state)
             paused = false;
         }
         btnPos += 24 + GUI_SPACING;
-        speedBtnActive = (speedLevel == 3 && !paused);
+        speedBtnActive = (speedLevel == 4 && !paused);
         GuiToggle((Rectangle){btnPos, 4, 24, 24}, GuiIconText(ICON_ARROW_RIGHT, NULL), &speedBtnActive);
         if (speedBtnActive)
         {
@@ -1095,7 +1038,7 @@ void level(GameState *state)
             paused = false;
         }
         btnPos += 24 + GUI_SPACING;
-        speedBtnActive = (speedLevel == 6 && !paused);
+        speedBtnActive = (speedLevel == 12 && !paused);
         GuiToggle((Rectangle){btnPos, 4, 24, 24}, GuiIconText(ICON_ARROW_RIGHT_FILL, NULL), &speedBtnActive);
         if (speedBtnActive)
         {
@@ -1103,22 +1046,41 @@ void level(GameState *state)
             paused = false;
         }
         btnPos += 24 + GUI_SPACING;
-        if (paused)
+        speedBtnActive = (speedLevel == SPEED_TURBO && !paused);
+        GuiToggle((Rectangle){btnPos, 4, 24, 24}, GuiIconText(ICON_PLAYER_NEXT, NULL), &speedBtnActive);
+        if (speedBtnActive)
+        {
+            if (speedLevel != SPEED_TURBO || paused)
+            {
+                turbo.rateStart = GetTime();
+                turbo.rateFrames = 0;
+            }
+            speedLevel = SPEED_TURBO;
+            paused = false;
+        }
+        btnPos += 24 + GUI_SPACING;
+        if (scrub.active)
+        {
+            scrub_draw(60);
+        }
+        else if (paused)
         {
             int textW = MeasureText("PAUSED", FONT_SIZE * 2);
             DrawText("PAUSED", (screenWidth - textW) / 2, 60, FONT_SIZE * 2, BLACK);
         }
+        else if (speedLevel == SPEED_TURBO)
+        {
+            turbo_draw(screenWidth - (GUI_SPACING + 24) * 5, 32);
+        }
 
         int xPos = 4;
         int yPos = screenHeight - BUTTON_SIZE - GUI_SPACING;
         for (int i = 0; i < ET_EOL; ++i)
         {
-            if ((state->home.allowedTowers & 1 << i) == 0)
+            if ((view->home.allowedTowers & 1 << i) == 0)
                 continue;
 
-            int scale = 1;
-            if (i == ET_MULT || i == ET_DIV)
-                scale = 2;
+            int scale = defaultTowerScale(i);
             snprintf(text, sizeof(text), SIGNS[i], scale);
             bool active = currentType == i;
             GuiToggle((Rectangle){ xPos, yPos, BUTTON_SIZE, BUTTON_SIZE}, text, &active);
@@ -1129,9 +1091,9 @@ void level(GameState *state)
             xPos += BUTTON_SIZE + GUI_SPACING;
         }
 
-        snprintf(text, sizeof(text), "Par: %d", state->home.minTowers);
+        snprintf(text, sizeof(text), "Par: %d", view->home.minTowers);
         DrawText(text, screenWidth - 150, screenHeight - FONT_SIZE * 2 - GUI_SPACING * 2, FONT_SIZE, BLACK);
-        snprintf(text, sizeof(text), "Precision: %.*f", (int)log10f(state->home.roundingFactor), 1 / (float)state->home.roundingFactor);
+        snprintf(text, sizeof(text), "Precision: %.*f", (int)log10f(view->home.roundingFactor), 1 / (float)view->home.roundingFactor);
         DrawText(text, screenWidth - 150, screenHeight - FONT_SIZE - GUI_SPACING, FONT_SIZE, BLACK);
         
     #ifdef _DEBUG
@@ -1139,18 +1101,18 @@ void level(GameState *state)
         snprintf(text, sizeof(text), "Frame: %u", frame);
         DrawText(text, 4, yPos, FONT_SIZE, BLACK);
         yPos += 24;
-        snprintf(text, sizeof(text), "Towers: %d / %d", state->towerLen, MAX_TOWERS);
+        snprintf(text, sizeof(text), "Towers: %d / %d", view->towerLen, MAX_TOWERS);
         DrawText(text, 4, yPos, FONT_SIZE, BLACK);
         yPos += 24;
-        snprintf(text, sizeof(text), "Enemies: %d - (%d / %d)", aliveCount, state->enemiesLen, MAX_ENEMIES);
+        snprintf(text, sizeof(text), "Enemies: %d / %d", aliveCount, MAX_ENEMIES);
         DrawText(text, 4, yPos, FONT_SIZE, BLACK);
         yPos += 24;
         snprintf(text, sizeof(text), "Queue: %d: %d -> %d", 
-            state->queueHead - state->queueTail, state->queueTail, state->queueHead);
+            view->queueHead - view->queueTail, view->queueTail, view->queueHead);
         DrawText(text, 4, yPos, FONT_SIZE, BLACK);
         yPos += 24;
         snprintf(text, sizeof(text), "Shots: %d: %d -> %d", 
-            state->shotHead - state->shotTail, state->shotTail, state->shotHead);
+            view->shotHead - view->shotTail, view->shotTail, view->shotHead);
         DrawText(text, 4, yPos, FONT_SIZE, BLACK);
         yPos += 24;
     #endif
@@ -1161,11 +1123,11 @@ void level(GameState *state)
         {
             DrawRectangle(0, 0, screenWidth, screenHeight, (Color){255, 255, 255, 128});
 
-            if (state->home.health > 0)
+            if (view->home.health > 0)
             {
                 int textW = MeasureText("You win!", 40);
                 DrawText("You win!", (screenWidth - textW) / 2, 80, 40, BLACK);
-                snprintf(text, sizeof(text), "Score: %d / 3", state->home.score);
+                snprintf(text, sizeof(text), "Score: %d / 3", score);
                 textW = MeasureText(text, 40);
                 DrawText(text, (screenWidth - textW) / 2, 120, 40, BLACK);
             }
@@ -1177,10 +1139,7 @@ void level(GameState *state)
 
             if (GuiButton((Rectangle){screenWidth / 2 - 120, 212, 116, 24}, "Try again"))
             {
-                state_reset(state);
-                memcpy(state->queue, queueBackup, QUEUE_SIZE * sizeof(queueBackup[0]));
-                state->queueHead = queueBackupHead;
-                frame = 0;
+                sim_send(state, &frame, threaded, &restart);
                 gameEnded = false;
             }
             if (GuiButton((Rectangle){screenWidth / 2 + 4, 212, 116, 24}, "Go to level select"))
@@ -1194,106 +1153,16 @@ void level(GameState *state)
 
         DrawScreenScaled();
     }
-}
-
-void level_logic(GameState *state, unsigned int frame)
-{
-    for (int i_enemy = 0; i_enemy < state->enemiesLen; ++i_enemy)
-    {
-        Enemy *e = state->enemies + i_enemy;
-        if (!e->alive)
-            continue;
 
-        // tower in range -> shoot
-        for (int i_tower = 0; i_tower < state->towerLen; ++i_tower)
-        {
-            Tower *t = state->towers + i_tower;
-            if (frame - t->lastShot < t->cooldown)
-                continue;
-            if (!CheckCollisionCircles(e->pos, ENEMY_SIZE, t->center, t->range))
-                continue;
-            if (!canTarget(t->type, e->health))
-                continue;
-            if (hasAlreadyTargeted(t->enemiesShot, TOWER_LIST_SIZE, i_enemy+1))
-                continue;
-
-            state->shots[state->shotHead % MAX_SIMUL_SHOTS] = (Shot){
-                .tower = i_tower,
-                .target = i_enemy, 
-                .type = t->type,
-                .scale = t->scale,
-                .shotLife = SHOT_LIFETIME,
-            };
-            ++state->shotHead;
-            t->lastShot = frame;
-            t->enemiesShot[t->shotIndex % TOWER_LIST_SIZE] = (i_enemy + 1);
-            t->shotIndex++;
-
-            int res = takeHealth(e, t, state->home.roundingFactor);
-
-            switch (res)
-            {
-                case TH_DEAD:
-                    e->alive = false;
-                    break;
-                case TH_SAVED_BY_ROUNDING:
-                    state->msg[state->msgIndex++ % SAVED_MSGS_MAX] = (SavedMessage){
-                        .pos = { e->pos.x - 30, e->pos.y - ENEMY_SIZE - GUI_SPACING },
-                        .frames = SAVED_MSG_LIFETIME,
-                    };
-                    printf("Saved by rounding\n");
-                    break;
-            }
-        }
-
-        // touch home -> remove itself + health
-        if (CheckCollisionPointRec(e->pos, state->home.rect))
-        {
-            --state->home.health;
-            e->alive = false;
-            continue;
-        }
-
-        e->pos = Vector2Add(e->pos, e->speed);
-    }
-    for (int i_shot = state->shotTail; i_shot != state->shotHead; ++i_shot)
-    {
-        Shot *s = state->shots + (i_shot % MAX_SIMUL_SHOTS);
-
-        if (s->shotLife == 0)
-        {
-            ++state->shotTail;
-            continue;
-        }
-
-        --s->shotLife;
-    }
-    // spawn new enemies
-    for (int i_queue = state->queueTail; i_queue != state->queueHead; ++i_queue)
-    {
-        EnemyQueue e = state->queue[i_queue % QUEUE_SIZE];
-        // check if frame is in the future (with rollover)
-        if (e.spawnFrame - frame < frame - e.spawnFrame)
-            break;
-
-        assert(state->enemiesLen < MAX_ENEMIES);
-        state->enemies[state->enemiesLen++] = (Enemy){
-            .pos = {screenWidth + 50, screenHeight / 2},
-            .speed = {-0.5, 0},
-            .health = e.health,
-            .alive = true,
-        };
-        ++state->queueTail;
-    }
-    // advance save msg
-    for (int i = 0; i < SAVED_MSGS_MAX; ++i)
-    {
-        state->msg[i].frames -= 1;
-        state->msg[i].pos.y += SAVED_MOVEY_PER_FRAME;
-    }
+    // leaving while rewound keeps the state shown
+    scrub_resume();
+    if (threaded)
+        simthread_stop(&simThread, state, &frame);
+    replay_finish(frame);
+    hint_free(&hint);
 }
 
-void level_draw(GameState *state)
+void level_draw(const GameState *state)
 {
     // Towers
     char text[64] = "";
@@ -1341,18 +1210,19 @@ void level_draw(GameState *state)
     // Enemies
     for (int i = state->enemiesLen-1; i >= 0; --i)
     {
-        Enemy e = state->enemies[i];
-        if (!e.alive)
+        if (!enemy_isAlive(&state->enemies, i))
             continue;
+        Vector2 pos = { state->enemies.x[i], state->enemies.y[i] };
+        float health = state->enemies.health[i];
 
-        DrawCircleV(e.pos, ENEMY_SIZE, enemyColor(e.health));
+        DrawCircleV(pos, ENEMY_SIZE, enemyColor(health));
         // %g is confusing. the precision option seems to specify the max total number of
         // significant digits (%.3g of 10.555 prints 10.6, while 0.555 prints 0.555).
         // Sometimes it will round, sometimes it won't (%.3g of 1.555 prints 1.55).
         if (roundingDigits > 0)
-            snprintf(text, sizeof(text), "%.*g", roundingDigits, e.health);
+            snprintf(text, sizeof(text), "%.*g", roundingDigits, health);
         else
-            snprintf(text, sizeof(text), "%f", e.health);
+            snprintf(text, sizeof(text), "%f", health);
         int fontSize = FONT_SIZE;
         textWidthPixels = MeasureText(text, fontSize);
         while (textWidthPixels > ENEMY_SIZE && fontSize > MIN_FONT_SIZE)
@@ -1361,16 +1231,16 @@ void level_draw(GameState *state)
             textWidthPixels = MeasureText(text, fontSize);
         }
         DrawText(text, 
-            e.pos.x - textWidthPixels / 2,
-            e.pos.y - fontSize / 2,
+            pos.x - textWidthPixels / 2,
+            pos.y - fontSize / 2,
             fontSize,
             BLACK);
     #ifdef _DEBUG
-        snprintf(text, sizeof(text), "%.4f", e.health);
+        snprintf(text, sizeof(text), "%.4f", health);
         textWidthPixels = MeasureText(text, 10);
         DrawText(text, 
-            e.pos.x - textWidthPixels / 2,
-            e.pos.y + fontSize / 2,
+            pos.x - textWidthPixels / 2,
+            pos.y + fontSize / 2,
             10,
             BLACK);
     #endif
@@ -1383,10 +1253,14 @@ void level_draw(GameState *state)
 
         Vector2 varTower = {rand() % 4 - 2, rand() % 4 - 2};
         Vector2 varTarget = {rand() % 8 - 4, rand() % 8 - 4};
+        Vector2 targetPos = s.targetPos;
+        int target = enemy_find(&state->enemies, s.target);
+        if (target >= 0)
+            targetPos = (Vector2){ state->enemies.x[target], state->enemies.y[target] };
 
         DrawLineV(
             Vector2Add(state->towers[s.tower].center, varTower), 
-            Vector2Add(state->enemies[s.target].pos, varTarget),
+            Vector2Add(targetPos, varTarget),
             RED);
     }
 
@@ -1411,12 +1285,11 @@ void playground(GameState *state)
 
     unsigned int frame = -600; // test rollover robustness
     
-    Rectangle path = {100, 200, screenWidth - 100, TOWER_SIZE};
+    Rectangle path = {(HOME_TILE_X + 1) * TOWER_SIZE, PATH_TILE_Y * TOWER_SIZE, screenWidth - (HOME_TILE_X + 1) * TOWER_SIZE, TOWER_SIZE};
     int currentType = ET_SUB;
     int currentScale = 1;
+    Ghost ghost = { .result.generation = atomic_get(&preview.requestGeneration) };
 
-    Rectangle guiArea = {0, screenHeight - BUTTON_SIZE - GUI_SPACING*2, screenWidth, BUTTON_SIZE + GUI_SPACING*2};
-    Rectangle guiAreaTop = {0, 0, screenWidth, TOWER_SIZE + 1};
     Rectangle countBox = {screenWidth - 124, 32, 120, 24};
     char countText[16] = "1";
     Rectangle healthBox = {screenWidth - 124, 60, 120, 24};
@@ -1430,12 +1303,34 @@ void playground(GameState *state)
     bool sceneChange = false;
     int speedLevel = 1;
 
+    replay_begin(&replay, -1, state, frame);
+    bool threaded = threadedSim && simthread_start(&simThread, state, frame);
+    if (threaded)
+        atomic_set(&simThread.stopWhenOver, false);
+    scrub_begin();
+    const GameState *view = state;
+
     // Main game loop
     while (!WindowShouldClose() && !sceneChange)
     {
         if (IsWindowResized())
             UpdateGlobalScaling();
 
+        unsigned int commands; // recorded before view, tags the rewind snapshots
+        if (threaded)
+        {
+            const SimSnapshot *snap = simthread_acquire(&simThread);
+            view = &snap->state;
+            frame = snap->frame;
+            commands = scrub.commandBase + snap->commandsApplied;
+        }
+        else
+        {
+            commands = replay.commands;
+        }
+        if (!scrub.active)
+            rewind_update(&rewindBuffer, view, frame, commands);
+
         // ------------------ Input ------------------
         if (IsKeyPressed(KEY_ESCAPE))
         {
@@ -1460,7 +1355,8 @@ void playground(GameState *state)
 
         if (IsKeyPressed(KEY_R))
         {
-            state_reset(state);
+            SimCommand cmd = { .type = CMD_RESET };
+            sim_send(state, &frame, threaded, &cmd);
         }
 
         int tileX = GetMouseX() / TOWER_SIZE;
@@ -1470,35 +1366,70 @@ void playground(GameState *state)
         {
             paused = !paused;
         }
+        // the arrow keys move the cursor of an edit box
+        if (editBoxActive == EB_NONE && scrub_step(state, &frame, &threaded))
+        {
+            view = state;
+            paused = true;
+        }
 
         // TODO: Optimize this / make a sane version of this check
         if (canPlaceTower)
         {
-            canPlaceTower = !CheckCollisionPointRec(GetMousePosition(), queueButton);
-            canPlaceTower &= !CheckCollisionPointRec(GetMousePosition(), guiAreaTop);
-            canPlaceTower &= !CheckCollisionPointRec(GetMousePosition(), path);
-            canPlaceTower &= !CheckCollisionPointRec(GetMousePosition(), state->home.rect);
-            canPlaceTower &= !CheckCollisionPointRec(GetMousePosition(), guiArea);
+            canPlaceTower = sim_canPlaceTile(tileX, tileY);
+            canPlaceTower &= !CheckCollisionPointRec(GetMousePosition(), queueButton);
             canPlaceTower &= !CheckCollisionPointRec(GetMousePosition(), 
                 CLITERAL(Rectangle){0, screenHeight - BUTTON_SIZE*2 - GUI_SPACING*3, BUTTON_SIZE + GUI_SPACING*2, BUTTON_SIZE + GUI_SPACING*2});
-            for (int i = 0; i < state->towerLen; ++i) {
-                canPlaceTower &= !CheckCollisionPointRec(GetMousePosition(), state->towers[i].rect);
+            for (int i = 0; i < view->towerLen; ++i) {
+                canPlaceTower &= !CheckCollisionPointRec(GetMousePosition(), view->towers[i].rect);
             }
         }
 
-        if (IsMouseButtonPressed(0) && state->towerLen < MAX_TOWERS && canPlaceTower && currentType != ET_NONE)
+        if (IsMouseButtonPressed(0) && view->towerLen < MAX_TOWERS && canPlaceTower && currentType != ET_NONE)
         {
-            state_addTower(state, tileX, tileY, currentType, currentScale);
+            SimCommand cmd = {
+                .type = CMD_ADD_TOWER,
+                .tileX = tileX,
+                .tileY = tileY,
+                .tower = currentType,
+                .scale = currentScale,
+            };
+            sim_send(state, &frame, threaded, &cmd);
         }
 
+        // predicted outcome of the tower under the mouse
+        SimCommand candidate = {
+            .type = CMD_ADD_TOWER,
+            .tileX = tileX,
+            .tileY = tileY,
+            .tower = currentType,
+            .scale = currentScale,
+        };
+        bool hovering = canPlaceTower && currentType != ET_NONE && view->towerLen < MAX_TOWERS;
+        ghost_update(&ghost, view, frame, hovering ? &candidate : NULL);
+
         // ------------------ Logic ------------------
-        if (!paused)
+        threaded = scrub_update(state, frame, threaded, paused);
+        if (!threaded && !scrub.active)
+            replay_recordSpeed(&replay, frame, paused ? REPLAY_PAUSED : speedLevel);
+        if (threaded)
         {
-            for (int i = 0; i < speedLevel; ++i)
+            atomic_set(&simThread.paused, paused);
+            atomic_set(&simThread.speed, speedLevel);
+            turbo.rateFrames += atomic_swap(&simThread.framesSimulated, 0);
+            turbo_measure(GetTime());
+        }
+        else if (!paused)
+        {
+            if (speedLevel == SPEED_TURBO)
+                turbo_run(state, &frame, false);
+            for (int i = 0; i < speedLevel; )
             {
-                level_logic(state, frame);
+                // skips ahead over frames where nothing but movement happens
+                unsigned int frames = level_advance(state, frame, speedLevel - i);
 
-                ++frame;
+                frame += frames;
+                i += frames;
             }
         }
 
@@ -1521,12 +1452,13 @@ void playground(GameState *state)
             }
         }
 
-        level_draw(state);
+        level_draw(view);
+        ghost_draw(&ghost, view, false);
 
         EndMode2D();
 
         // GUI
-        int btnPos = (screenWidth - 3 * 24 - 2 * GUI_SPACING) / 2;
+        int btnPos = (screenWidth - 4 * 24 - 3 * GUI_SPACING) / 2;
         bool speedBtnActive = paused;
         GuiToggle((Rectangle){btnPos, 4, 24, 24}, GuiIconText(ICON_PLAYER_PAUSE, NULL), &speedBtnActive);
         paused = speedBtnActive;
@@ -1539,19 +1471,41 @@ void playground(GameState *state)
             paused = false;
         }
         btnPos += 24 + GUI_SPACING;
-        speedBtnActive = (speedLevel > 1 && !paused);
-        GuiToggle((Rectangle){btnPos, 4, 24, 24}, GuiIconText(ICON_PLAYER_NEXT, NULL), &speedBtnActive);
+        speedBtnActive = (speedLevel == 4 && !paused);
+        GuiToggle((Rectangle){btnPos, 4, 24, 24}, GuiIconText(ICON_ARROW_RIGHT, NULL), &speedBtnActive);
         if (speedBtnActive)
         {
             speedLevel = 4;
             paused = false;
         }
         btnPos += 24 + GUI_SPACING;
-        if (paused)
+        speedBtnActive = (speedLevel == SPEED_TURBO && !paused);
+        GuiToggle((Rectangle){btnPos, 4, 24, 24}, GuiIconText(ICON_PLAYER_NEXT, NULL), &speedBtnActive);
+        if (speedBtnActive)
+        {
+            if (speedLevel != SPEED_TURBO || paused)
+            {
+                turbo.rateStart = GetTime();
+                turbo.rateFrames = 0;
+            }
+            speedLevel = SPEED_TURBO;
+            paused = false;
+        }
+        btnPos += 24 + GUI_SPACING;
+        if (scrub.active)
+        {
+            scrub_draw(40);
+        }
+        else if (paused)
         {
             int textW = MeasureText("PAUSED", FONT_SIZE * 2);
             DrawText("PAUSED", (screenWidth - textW) / 2, 40, FONT_SIZE * 2, BLACK);
         }
+        else if (speedLevel == SPEED_TURBO)
+        {
+            int textW = MeasureText("Turbo 00 ms: 0000000 frames/s", FONT_SIZE / 2);
+            turbo_draw((screenWidth - textW) / 2, 32);
+        }
 
         btnPos = screenWidth - GUI_SPACING - 60;
         if (GuiButton((Rectangle){btnPos, 4, 60, 24}, "Primes"))
@@ -1608,7 +1562,13 @@ void playground(GameState *state)
             assert(count > 0);
             assert(spacing > 0);
 
-            state_addQueueFromString(state, frame, healthText, count, spacing);
+            SimCommand cmd = {
+                .type = CMD_ADD_QUEUE,
+                .count = count,
+                .spacing = spacing,
+            };
+            snprintf(cmd.health, sizeof(cmd.health), "%s", healthText);
+            sim_send(state, &frame, threaded, &cmd);
         }
 
         int xPos = 4;
@@ -1628,7 +1588,7 @@ void playground(GameState *state)
         char text[64] = "";
         for (int i = 0; i < ET_EOL; ++i)
         {
-            if ((state->home.allowedTowers & 1 << i) == 0)
+            if ((view->home.allowedTowers & 1 << i) == 0)
                 continue;
 
             if (i == ET_ROUND)
@@ -1648,32 +1608,36 @@ void playground(GameState *state)
         if (GuiButton((Rectangle){xPos, yPos, (BUTTON_SIZE - GUI_SPACING) / 2, BUTTON_SIZE}, 
             GuiIconText(ICON_ARROW_LEFT, NULL)))
         {
-            if (state->home.roundingFactor > 1)
+            SimCommand cmd = { .type = CMD_SET_ROUNDING, .roundingFactor = view->home.roundingFactor };
+            if (cmd.roundingFactor > 1)
             {
-                state->home.roundingFactor /= 10;
+                cmd.roundingFactor /= 10;
             }
-            else if (state->home.roundingFactor == 1)
+            else if (cmd.roundingFactor == 1)
             {
-                state->home.roundingFactor = 0;
+                cmd.roundingFactor = 0;
             }
+            sim_send(state, &frame, threaded, &cmd);
         }
         if (GuiButton((Rectangle){xPos + (BUTTON_SIZE + GUI_SPACING) / 2, yPos, (BUTTON_SIZE - GUI_SPACING) / 2, BUTTON_SIZE}, 
             GuiIconText(ICON_ARROW_RIGHT, NULL)))
         {
-            if (state->home.roundingFactor == 0)
+            SimCommand cmd = { .type = CMD_SET_ROUNDING, .roundingFactor = view->home.roundingFactor };
+            if (cmd.roundingFactor == 0)
             {
-                state->home.roundingFactor = 1;
+                cmd.roundingFactor = 1;
             }
-            else if (state->home.roundingFactor < 1e8)
+            else if (cmd.roundingFactor < 1e8)
             {
-                state->home.roundingFactor *= 10;
+                cmd.roundingFactor *= 10;
             }
+            sim_send(state, &frame, threaded, &cmd);
         }
         xPos += BUTTON_SIZE + GUI_SPACING * 2;
-        if (state->home.roundingFactor == 0)
+        if (view->home.roundingFactor == 0)
             snprintf(text, sizeof(text), "Precision: full float");
         else
-            snprintf(text, sizeof(text), "Precision: %.*f", (int)log10f(state->home.roundingFactor), 1 / (float)state->home.roundingFactor);
+            snprintf(text, sizeof(text), "Precision: %.*f", (int)log10f(view->home.roundingFactor), 1 / (float)view->home.roundingFactor);
         DrawText(text, xPos, yPos + (BUTTON_SIZE - FONT_SIZE) / 2, FONT_SIZE, BLACK);
 
     #ifdef _DEBUG
@@ -1681,26 +1645,18 @@ void playground(GameState *state)
         snprintf(text, sizeof(text), "Frame: %u", frame);
         DrawText(text, 4, yPos, FONT_SIZE, BLACK);
         yPos += 24;
-        snprintf(text, sizeof(text), "Towers: %d / %d", state->towerLen, MAX_TOWERS);
+        snprintf(text, sizeof(text), "Towers: %d / %d", view->towerLen, MAX_TOWERS);
         DrawText(text, 4, yPos, FONT_SIZE, BLACK);
         yPos += 24;
-        int aliveCount = 0;
-        for (int i = state->enemiesLen-1; i >= 0; --i)
-        {
-            if (!state->enemies[i].alive)
-                continue;
-
-            ++aliveCount;
-        }
-        snprintf(text, sizeof(text), "Enemies: %d - (%d / %d)", aliveCount, state->enemiesLen, MAX_ENEMIES);
+        snprintf(text, sizeof(text), "Enemies: %d / %d", view->enemiesLen, MAX_ENEMIES);
         DrawText(text, 4, yPos, FONT_SIZE, BLACK);
         yPos += 24;
         snprintf(text, sizeof(text), "Queue: %d: %d -> %d", 
-            state->queueHead - state->queueTail, state->queueTail, state->queueHead);
+            view->queueHead - view->queueTail, view->queueTail, view->queueHead);
         DrawText(text, 4, yPos, FONT_SIZE, BLACK);
         yPos += 24;
         snprintf(text, sizeof(text), "Shots: %d: %d -> %d", 
-            state->shotHead - state->shotTail, state->shotTail, state->shotHead);
+            view->shotHead - view->shotTail, view->shotTail, view->shotHead);
         DrawText(text, 4, yPos, FONT_SIZE, BLACK);
         yPos += 24;
 
@@ -1712,4 +1668,10 @@ void playground(GameState *state)
 
         DrawScreenScaled();
     }
+
+    // leaving while rewound keeps the state shown
+    scrub_resume();
+    if (threaded)
+        simthread_stop(&simThread, state, &frame);
+    replay_finish(frame);
 }
@@ -0,0 +1,66 @@
+// Checks the par (LevelDef.minSolution) of every shipped level with the solver.
+// Usage: par_check [level index], exits with 1 if any par is wrong.
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "sim.h"
+#include "solver.h"
+#include "thread.h"
+#include "levels.h"
+
+#define PAR_CHECK_EXTRA_DEPTH 2 // how far past the par to look when it cannot be reached
+
+int main(int argc, char **argv)
+{
+    int first = 0;
+    int last = ARRAY_SIZE(LEVELS) - 1;
+    if (argc > 1)
+        first = last = atoi(argv[1]);
+
+    GameState state;
+    state_init(&state);
+    HealthCache cache;
+    cache_init(&cache, HEALTH_CACHE_BITS_DEFAULT);
+    state.healthCache = &cache;
+
+    int wrong = 0;
+    for (int i = first; i <= last && i < (int)ARRAY_SIZE(LEVELS); ++i)
+    {
+        const LevelDef *def = LEVELS + i;
+        SolverLevel level;
+        solver_initLevel(&level, def);
+
+        Solution solution;
+        double start = thread_time();
+        int par = solver_solveParallel(&level, def->minSolution + PAR_CHECK_EXTRA_DEPTH, thread_cpuCount(), &solution);
+        double seconds = thread_time() - start;
+
+        char text[256] = "no solution";
+        if (par >= 0)
+            solver_describe(&solution, text, sizeof(text));
+        const char *status = "ok";
+        if (par < 0)
+        {
+            status = "WRONG (par not reachable)";
+            ++wrong;
+        }
+        else if (solver_playSolution(&state, def, i, &solution) != HEALTH_DEFAULT)
+        {
+            // the model misses something (e.g. overlapping tower ranges), no verdict
+            status = "unverified (solution fails in simulation)";
+        }
+        else if (par != def->minSolution)
+        {
+            status = "WRONG";
+            ++wrong;
+        }
+        printf("%2d %-24s par %2d solver %2d  %.2fs  %-8s %s\n", i, def->name, def->minSolution, par, seconds, status, text);
+    }
+
+    state_free(&state);
+    cache_free(&cache);
+    if (wrong > 0)
+        printf("%d par value(s) do not match the solver\n", wrong);
+    return wrong > 0 ? 1 : 0;
+}
@@ -0,0 +1,69 @@
+// Plays replays recorded by the game (replay.mtdr, see src/replay.h) headlessly, as
+// fast as the simulation goes. Usage: playback <replay file>...
+// Prints the scene, the frames played and the state at the end of every replay (the
+// score as shown by the game for levels), exits with 1 if a replay is invalid or does
+// not play out like it was recorded.
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "sim.h"
+#include "replay.h"
+#include "thread.h"
+#include "levels.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: playback <replay file>...\n");
+        return 1;
+    }
+
+    GameState state;
+    state_init(&state);
+    HealthCache cache;
+    cache_init(&cache, HEALTH_CACHE_BITS_DEFAULT);
+    state.healthCache = &cache;
+    Replay replay;
+    replay_init(&replay, REPLAY_SIZE_DEFAULT);
+
+    int failed = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!replay_load(&replay, argv[i]))
+        {
+            printf("%s: ERROR: Could not read file\n", argv[i]);
+            ++failed;
+            continue;
+        }
+
+        ReplayReader reader;
+        unsigned int frame = 0;
+        double start = thread_time();
+        ReplayStatus status = replay_play(&reader, &replay, &state, &frame);
+        double seconds = thread_time() - start;
+        if (status != REPLAY_OK)
+        {
+            printf("%s: ERROR: %s\n", argv[i], status == REPLAY_INVALID ? "not a valid replay" : "played out differently than recorded");
+            ++failed;
+            continue;
+        }
+
+        // a restart may have loaded another level
+        const char *scene = reader.levelIndex < 0 ? "Playground" : LEVELS[state.home.levelIndex].name;
+        const char *result = "not over";
+        if (state.home.health <= 0)
+            result = "lose";
+        else if (state_isOver(&state))
+            result = "win";
+        printf("%s: %-24s frame %10u  %-8s  health %2d  towers %2u  enemies %4u  score %d/3  %.3f ms\n",
+            argv[i], scene, frame, result, state.home.health, state.towerLen, state.enemiesLen,
+            reader.levelIndex < 0 ? 0 : state_score(&state), seconds * 1000);
+    }
+
+    replay_free(&replay);
+    state_free(&state);
+    cache_free(&cache);
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,192 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "preview.h"
+#include "sim_simd.h"
+
+#define ENEMY_SLOT(h) ((h) & ((1u << ENEMY_HANDLE_SLOT_BITS) - 1))
+
+void preview_init(Preview *p)
+{
+    *p = (Preview){ 0 };
+    state_init(&p->request);
+    state_init(&p->state);
+    cache_init(&p->cache, HEALTH_CACHE_BITS_DEFAULT);
+    p->state.healthCache = &p->cache;
+}
+
+void preview_free(Preview *p)
+{
+    if (p->running)
+        preview_stop(p);
+    state_free(&p->request);
+    state_free(&p->state);
+    cache_free(&p->cache);
+}
+
+// Plays p->state to the end and fills p->work. Returns false if a newer request came in.
+static bool preview_simulate(Preview *p, unsigned int frame, const SimCommand *tower, int generation)
+{
+    GameState *s = &p->state;
+    PreviewResult *r = &p->work;
+    EnemyList *e = &s->enemies;
+
+    r->generation = generation;
+    r->enemyLen = s->enemiesLen;
+    r->queueLen = s->queueHead - s->queueTail;
+    for (int i = 0; i < r->enemyLen + r->queueLen; ++i)
+        r->outcome[i] = EO_DIES;
+    for (int i = 0; i < r->enemyLen; ++i)
+    {
+        r->handle[i] = e->handle[i];
+        p->slotId[ENEMY_SLOT(e->handle[i])] = i;
+    }
+    unsigned int firstQueued = s->queueTail;
+    r->firstQueued = firstQueued;
+
+    r->valid = sim_applyCommand(s, &frame, tower);
+    if (!r->valid)
+        return true;
+
+    for (int f = 0; !state_isOver(s) && f < PREVIEW_MAX_FRAMES; ++f)
+    {
+        if (atomic_get(&p->requestGeneration) != generation)
+            return false;
+
+        // level_logic tests home against the positions at the start of the frame
+        for (unsigned int w = 0; w < (s->enemiesLen + 31) / 32; ++w)
+        {
+            unsigned int live = e->alive[w];
+            if (s->enemiesLen - w * 32 < 32)
+                live &= (1u << (s->enemiesLen - w * 32)) - 1;
+            unsigned int home = live & simd_rectMask32(e->x + w * 32, e->y + w * 32, s->home.rect);
+            for (unsigned int i = 0; i < 32; ++i)
+            {
+                if (home & (1u << i))
+                    r->outcome[p->slotId[ENEMY_SLOT(e->handle[w * 32 + i])]] = EO_HOME;
+            }
+        }
+
+        unsigned int tail = s->queueTail;
+        level_logic(s, frame++);
+        // spawned enemies are appended in queue order
+        unsigned int spawned = s->queueTail - tail;
+        for (unsigned int i = 0; i < spawned; ++i)
+        {
+            unsigned int i_enemy = s->enemiesLen - spawned + i;
+            p->slotId[ENEMY_SLOT(e->handle[i_enemy])] = r->enemyLen + (tail + i - firstQueued);
+        }
+    }
+
+    // whatever is left when home dies (or time ran out) did not get anywhere yet
+    for (unsigned int i = 0; i < s->enemiesLen; ++i)
+        r->outcome[p->slotId[ENEMY_SLOT(e->handle[i])]] = EO_PENDING;
+    for (unsigned int i = s->queueTail; i != s->queueHead; ++i)
+        r->outcome[r->enemyLen + (i - firstQueued)] = EO_PENDING;
+
+    r->dies = r->reachesHome = 0;
+    for (int i = 0; i < r->enemyLen + r->queueLen; ++i)
+    {
+        r->dies += (r->outcome[i] == EO_DIES);
+        r->reachesHome += (r->outcome[i] == EO_HOME);
+    }
+    r->health = s->home.health;
+    r->score = state_score(s);
+    return true;
+}
+
+static void preview_run(void *arg)
+{
+    Preview *p = arg;
+    int taken = 0; // requests sent before the thread got going still count
+
+    while (atomic_get(&p->running))
+    {
+        int generation = atomic_get(&p->requestGeneration);
+        if (generation == taken || !atomic_cas(&p->requestLock, 0, 1))
+        {
+            thread_sleepMs(1);
+            continue;
+        }
+
+        // the generation cannot change while we hold the lock
+        taken = atomic_get(&p->requestGeneration);
+        bool valid = p->requestValid;
+        unsigned int frame = p->requestFrame;
+        SimCommand tower = p->requestTower;
+        if (valid)
+            state_copy(&p->state, &p->request);
+        atomic_set(&p->requestLock, 0);
+
+        if (!valid || !preview_simulate(p, frame, &tower, taken))
+            continue;
+
+        while (!atomic_cas(&p->resultLock, 0, 1))
+            ; // the renderer only holds it for a copy
+        p->result = p->work;
+        atomic_set(&p->resultLock, 0);
+    }
+}
+
+bool preview_start(Preview *p)
+{
+    atomic_set(&p->running, 1);
+    if (!thread_start(&p->thread, preview_run, p))
+    {
+        printf("WARNING: Could not start preview thread\n");
+        atomic_set(&p->running, 0);
+        return false;
+    }
+    return true;
+}
+
+void preview_stop(Preview *p)
+{
+    atomic_set(&p->running, 0);
+    thread_join(&p->thread);
+}
+
+bool preview_request(Preview *p, const GameState *state, unsigned int frame, const SimCommand *tower)
+{
+    if (!atomic_cas(&p->requestLock, 0, 1))
+        return false;
+
+    p->requestValid = (state != NULL);
+    if (state)
+    {
+        state_copy(&p->request, state);
+        p->requestFrame = frame;
+        p->requestTower = *tower;
+    }
+    atomic_add(&p->requestGeneration, 1);
+    atomic_set(&p->requestLock, 0);
+    return true;
+}
+
+bool preview_poll(Preview *p, PreviewResult *out)
+{
+    if (atomic_get(&p->resultLock) == 0 && atomic_cas(&p->resultLock, 0, 1))
+    {
+        if (p->result.generation > out->generation)
+            *out = p->result;
+        atomic_set(&p->resultLock, 0);
+    }
+    return out->generation != 0 && out->generation == atomic_get(&p->requestGeneration);
+}
+
+int preview_enemyOutcome(const PreviewResult *r, EnemyHandle h)
+{
+    for (int i = 0; i < r->enemyLen; ++i)
+    {
+        if (r->handle[i] == h)
+            return r->outcome[i];
+    }
+    return -1;
+}
+
+int preview_queuedOutcome(const PreviewResult *r, unsigned int i)
+{
+    if (i - r->firstQueued >= (unsigned int)r->queueLen)
+        return -1;
+    return r->outcome[r->enemyLen + (i - r->firstQueued)];
+}
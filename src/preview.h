@@ -0,0 +1,80 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+// Predicts the outcome of placing a tower: a worker thread plays a copy of the state
+// with the candidate tower until the level is over. Every new request cancels the
+// one in progress (checked each simulated frame). The renderer never waits: request
+// and result slots are guarded by try-locks, a busy slot just means trying again
+// next frame.
+
+#include "sim.h"
+#include "thread.h"
+
+#define PREVIEW_ENEMIES_MAX (MAX_ENEMIES + QUEUE_SIZE)
+#define PREVIEW_MAX_FRAMES (60 * 60 * 10) // ten minutes of game time
+
+typedef enum EnemyOutcome
+{
+    EO_DIES,
+    EO_HOME, // reaches home
+    EO_PENDING, // still around when home dies
+} EnemyOutcome;
+
+typedef struct PreviewResult
+{
+    int generation; // of the request, 0: none yet
+    bool valid; // false if the tower could not be placed
+    // live enemies at the time of the request in list order, then the queue from queueTail
+    unsigned char outcome[PREVIEW_ENEMIES_MAX];
+    EnemyHandle handle[MAX_ENEMIES]; // of the live enemies
+    int enemyLen;
+    unsigned int firstQueued; // queueTail at the time of the request
+    int queueLen;
+    int dies;
+    int reachesHome;
+    int health;
+    int score; // see state_score
+} PreviewResult;
+
+typedef struct Preview
+{
+    Thread thread;
+    volatile int running;
+
+    // written by the renderer while holding requestLock
+    GameState request;
+    unsigned int requestFrame;
+    SimCommand requestTower;
+    bool requestValid; // false: cancel only
+    volatile int requestLock;
+    volatile int requestGeneration;
+
+    // owned by the worker
+    GameState state;
+    HealthCache cache;
+    int slotId[MAX_ENEMIES]; // handle slot -> outcome index
+    PreviewResult work;
+
+    // written by the worker while holding resultLock
+    PreviewResult result;
+    volatile int resultLock;
+} Preview;
+
+void preview_init(Preview *p);
+void preview_free(Preview *p);
+// returns false if threads are unavailable
+bool preview_start(Preview *p);
+void preview_stop(Preview *p);
+// Asks for the outcome of applying tower (a CMD_ADD_TOWER) to state at frame, NULL
+// state just cancels. Returns false without waiting if the worker is picking up the
+// previous request, call again next frame then.
+bool preview_request(Preview *p, const GameState *state, unsigned int frame, const SimCommand *tower);
+// Copies the newest finished result into out if it is newer than out. Returns true if
+// out holds the result of the latest request.
+bool preview_poll(Preview *p, PreviewResult *out);
+// EnemyOutcome of a live enemy, -1 if it was not around at the time of the request
+int preview_enemyOutcome(const PreviewResult *r, EnemyHandle h);
+// EnemyOutcome of the entry at queue index i (counting like queueTail), -1 if unknown
+int preview_queuedOutcome(const PreviewResult *r, unsigned int i);
+
+#endif // PREVIEW_H
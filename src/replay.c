@@ -0,0 +1,353 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#include "replay.h"
+#include "levels.h"
+
+#define REPLAY_MAGIC "MTDR"
+#define REPLAY_END_MAX 8 // kept free for the end: frame delta and type
+#define REPLAY_EVENT_MAX (48 + SIM_COMMAND_TEXT_SIZE)
+
+// an event is put together here first, so it is written completely or not at all
+typedef struct ReplayWriter
+{
+    unsigned char data[REPLAY_EVENT_MAX];
+    unsigned int len;
+} ReplayWriter;
+
+static void writer_uint(ReplayWriter *w, unsigned int x)
+{
+    while (x >= 0x80)
+    {
+        w->data[w->len++] = (unsigned char)(x | 0x80);
+        x >>= 7;
+    }
+    w->data[w->len++] = (unsigned char)x;
+}
+
+static void writer_int(ReplayWriter *w, int x)
+{
+    writer_uint(w, ((unsigned int)x << 1) ^ (unsigned int)(x >> 31));
+}
+
+static void replay_write(Replay *r, const ReplayWriter *w, unsigned int reserve)
+{
+    if (r->full || r->len + w->len + reserve > r->size)
+    {
+        r->full = true;
+        return;
+    }
+    memcpy(r->data + r->len, w->data, w->len);
+    r->len += w->len;
+}
+
+static bool reader_uint(ReplayReader *rr, unsigned int *x)
+{
+    const Replay *r = rr->replay;
+    unsigned int value = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        if (rr->pos >= r->len)
+            break;
+        unsigned char byte = r->data[rr->pos++];
+        value |= (unsigned int)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            *x = value;
+            return true;
+        }
+    }
+    rr->error = true;
+    return false;
+}
+
+static bool reader_int(ReplayReader *rr, int *x)
+{
+    unsigned int u;
+    if (!reader_uint(rr, &u))
+        return false;
+    *x = (int)(u >> 1) ^ -(int)(u & 1);
+    return true;
+}
+
+void replay_init(Replay *r, unsigned int size)
+{
+    *r = (Replay){ .size = size };
+    r->data = calloc(size, 1);
+}
+
+void replay_free(Replay *r)
+{
+    free(r->data);
+    *r = (Replay){ 0 };
+}
+
+void replay_begin(Replay *r, int levelIndex, const GameState *state, unsigned int frame)
+{
+    r->len = 0;
+    r->full = false;
+    r->lastFrame = frame;
+    r->lastSpeed = INT_MIN; // the first speed is always written
+    r->commands = 0;
+
+    ReplayWriter w = { .len = 0 };
+    memcpy(w.data, REPLAY_MAGIC, 4);
+    w.len = 4;
+    writer_uint(&w, REPLAY_VERSION);
+    writer_uint(&w, frame);
+    writer_uint(&w, levelIndex + 1);
+    writer_uint(&w, state->home.allowedTowers);
+    writer_int(&w, state->home.roundingFactor);
+    replay_write(r, &w, REPLAY_END_MAX);
+}
+
+static void writer_event(ReplayWriter *w, Replay *r, unsigned int frame, ReplayEventType type)
+{
+    writer_uint(w, frame - r->lastFrame);
+    writer_uint(w, type);
+}
+
+void replay_recordCommand(Replay *r, unsigned int frame, const SimCommand *cmd, bool accepted)
+{
+    ++r->commands;
+    ReplayWriter w = { .len = 0 };
+    writer_event(&w, r, frame, RE_COMMAND);
+    writer_uint(&w, cmd->type);
+    writer_uint(&w, accepted);
+    switch (cmd->type)
+    {
+        case CMD_ADD_TOWER:
+            writer_int(&w, cmd->tileX);
+            writer_int(&w, cmd->tileY);
+            writer_uint(&w, cmd->tower);
+            writer_int(&w, cmd->scale);
+            break;
+        case CMD_ADD_QUEUE:
+        {
+            unsigned int len = strnlen(cmd->health, SIM_COMMAND_TEXT_SIZE - 1);
+            writer_uint(&w, len);
+            memcpy(w.data + w.len, cmd->health, len);
+            w.len += len;
+            writer_uint(&w, cmd->count);
+            writer_uint(&w, cmd->spacing);
+            break;
+        }
+        case CMD_LOAD_LEVEL:
+            writer_uint(&w, cmd->levelIndex);
+            break;
+        case CMD_SET_ROUNDING:
+            writer_int(&w, cmd->roundingFactor);
+            break;
+        default:
+            break;
+    }
+    replay_write(r, &w, REPLAY_END_MAX);
+    if (!r->full)
+        r->lastFrame = frame;
+}
+
+void replay_recordSpeed(Replay *r, unsigned int frame, int speed)
+{
+    if (speed == r->lastSpeed)
+        return;
+    ReplayWriter w = { .len = 0 };
+    writer_event(&w, r, frame, RE_SPEED);
+    writer_int(&w, speed);
+    replay_write(r, &w, REPLAY_END_MAX);
+    if (!r->full)
+    {
+        r->lastFrame = frame;
+        r->lastSpeed = speed;
+    }
+}
+
+void replay_end(Replay *r, unsigned int frame)
+{
+    // a full recording ends where it stopped
+    ReplayWriter w = { .len = 0 };
+    writer_event(&w, r, r->full ? r->lastFrame : frame, RE_END);
+    bool full = r->full;
+    r->full = false;
+    replay_write(r, &w, 0);
+    r->full = full;
+}
+
+bool replay_save(const Replay *r, const char *filename)
+{
+    FILE *f = fopen(filename, "wb");
+    if (f == NULL)
+        return false;
+    bool ok = fwrite(r->data, 1, r->len, f) == r->len;
+    return fclose(f) == 0 && ok;
+}
+
+bool replay_load(Replay *r, const char *filename)
+{
+    FILE *f = fopen(filename, "rb");
+    if (f == NULL)
+        return false;
+    r->len = (unsigned int)fread(r->data, 1, r->size, f);
+    r->full = false;
+    bool ok = !ferror(f) && fgetc(f) == EOF && feof(f);
+    fclose(f);
+    return ok;
+}
+
+// reads the start of r up to the first event
+static bool reader_begin(ReplayReader *reader, const Replay *r, unsigned int *allowedTowers, int *roundingFactor)
+{
+    *reader = (ReplayReader){ .replay = r, .pos = 4, .levelIndex = -1 };
+    unsigned int version = 0, level = 0;
+    if (r->len < 4 || memcmp(r->data, REPLAY_MAGIC, 4) != 0
+        || !reader_uint(reader, &version) || version != REPLAY_VERSION
+        || !reader_uint(reader, &reader->frame)
+        || !reader_uint(reader, &level) || level > ARRAY_SIZE(LEVELS)
+        || !reader_uint(reader, allowedTowers)
+        || !reader_int(reader, roundingFactor))
+    {
+        reader->error = true;
+        return false;
+    }
+    reader->levelIndex = (int)level - 1;
+    return true;
+}
+
+bool replay_start(ReplayReader *reader, const Replay *r, GameState *state, unsigned int *frame)
+{
+    unsigned int allowedTowers = 0;
+    int roundingFactor = 0;
+    if (!reader_begin(reader, r, &allowedTowers, &roundingFactor))
+        return false;
+
+    state_reset(state);
+    if (reader->levelIndex >= 0)
+    {
+        state_loadFromLevelDef(state, LEVELS[reader->levelIndex], reader->levelIndex);
+    }
+    else
+    {
+        state->home.allowedTowers = allowedTowers;
+        state->home.roundingFactor = roundingFactor;
+    }
+    *frame = reader->frame;
+    return true;
+}
+
+void replay_truncate(Replay *r, unsigned int commands)
+{
+    // a full recording may not hold that many, then there is nothing after them
+    if (commands > r->commands)
+        return;
+
+    ReplayReader reader;
+    unsigned int allowedTowers;
+    int roundingFactor;
+    if (!reader_begin(&reader, r, &allowedTowers, &roundingFactor))
+        return;
+    // r has no end yet, reading stops with an error at the end of the data
+    unsigned int cut = reader.pos;
+    unsigned int cutFrame = reader.frame;
+    unsigned int found = 0;
+    ReplayEvent e;
+    while (found < commands && replay_next(&reader, &e))
+    {
+        if (e.type != RE_COMMAND)
+            continue;
+        ++found;
+        cut = reader.pos;
+        cutFrame = e.frame;
+    }
+    if (found < commands)
+        return;
+
+    // speed changes after the cut may be at later frames than the state, they go too
+    r->len = cut;
+    r->full = false;
+    r->lastFrame = cutFrame;
+    r->lastSpeed = INT_MIN;
+    r->commands = commands;
+}
+
+bool replay_next(ReplayReader *reader, ReplayEvent *e)
+{
+    unsigned int delta, type;
+    if (reader->error || !reader_uint(reader, &delta) || !reader_uint(reader, &type) || type >= RE_EOL)
+    {
+        reader->error = true;
+        return false;
+    }
+    reader->frame += delta;
+    e->frame = reader->frame;
+    e->type = type;
+    if (type == RE_END)
+        return false;
+    if (type == RE_SPEED)
+        return reader_int(reader, &e->speed);
+
+    SimCommand *cmd = &e->command;
+    unsigned int cmdType = CMD_NONE, accepted = 0, tower = ET_NONE, len = 0, levelIndex = 0;
+    if (!reader_uint(reader, &cmdType) || !reader_uint(reader, &accepted))
+        return false;
+    *cmd = (SimCommand){ .type = cmdType };
+    e->accepted = accepted != 0;
+    bool ok = true;
+    switch (cmdType)
+    {
+        case CMD_ADD_TOWER:
+            ok = reader_int(reader, &cmd->tileX) && reader_int(reader, &cmd->tileY)
+                && reader_uint(reader, &tower) && tower < ET_EOL
+                && reader_int(reader, &cmd->scale);
+            cmd->tower = tower;
+            break;
+        case CMD_ADD_QUEUE:
+            ok = reader_uint(reader, &len) && len < SIM_COMMAND_TEXT_SIZE && len <= reader->replay->len - reader->pos;
+            if (!ok)
+                break;
+            memcpy(cmd->health, reader->replay->data + reader->pos, len);
+            reader->pos += len;
+            ok = reader_uint(reader, &cmd->count) && reader_uint(reader, &cmd->spacing);
+            break;
+        case CMD_RESET:
+            break;
+        case CMD_LOAD_LEVEL:
+            ok = reader_uint(reader, &levelIndex) && levelIndex < ARRAY_SIZE(LEVELS);
+            if (ok)
+            {
+                cmd->level = LEVELS[levelIndex];
+                cmd->levelIndex = levelIndex;
+            }
+            break;
+        case CMD_SET_ROUNDING:
+            ok = reader_int(reader, &cmd->roundingFactor);
+            break;
+        default:
+            ok = false;
+            break;
+    }
+    if (!ok)
+        reader->error = true;
+    return ok;
+}
+
+ReplayStatus replay_play(ReplayReader *reader, const Replay *r, GameState *state, unsigned int *frame)
+{
+    if (!replay_start(reader, r, state, frame))
+        return REPLAY_INVALID;
+
+    ReplayEvent e;
+    bool more;
+    do
+    {
+        more = replay_next(reader, &e);
+        if (reader->error)
+            return REPLAY_INVALID;
+        // frames may wrap around, the event is never behind
+        while (*frame != e.frame)
+            *frame += level_advance(state, *frame, e.frame - *frame);
+        if (more && e.type == RE_COMMAND && sim_applyCommand(state, frame, &e.command) != e.accepted)
+            return REPLAY_DIVERGED;
+    } while (more);
+    return REPLAY_OK;
+}
@@ -0,0 +1,111 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+// Input recording of a level or the playground: the state at the start, then every
+// command applied to the simulation and every change of the playback speed, each with
+// the frame it happened at. The simulation is deterministic and level_advance gives
+// the same state as stepping frame by frame, so applying the same commands at the
+// same frames reproduces the game exactly. The speed is only needed to watch a replay
+// in real time, playing one back headlessly ignores it.
+//
+// Binary format, every number a varint (7 bits per byte, low bits first, the high
+// bit set if more bytes follow), signed numbers zigzag encoded:
+//   "MTDR" version
+//   start frame, level index + 1 (0: playground), allowedTowers, roundingFactor
+//   events: frame delta, event type, payload
+//     RE_END
+//     RE_SPEED     speed (signed)
+//     RE_COMMAND   SimCommandType, result (1: accepted by sim_applyCommand), then
+//       CMD_ADD_TOWER     tileX, tileY (signed), tower, scale (signed)
+//       CMD_ADD_QUEUE     health string length and bytes, count, spacing
+//       CMD_LOAD_LEVEL    level index into LEVELS (src/levels.h)
+//       CMD_SET_ROUNDING  roundingFactor (signed)
+// Frame deltas are to the frame of the event before (the start frame for the first)
+// and wrap around like the frame counter does. Rejected commands are recorded too, a
+// queue that did not fit completely is rejected but the part that fit was added.
+
+#include "sim.h"
+
+#define REPLAY_VERSION 1
+#define REPLAY_SIZE_DEFAULT (64 * 1024) // bytes, a few thousand towers and queues
+#define REPLAY_PAUSED 0 // speed while paused
+
+typedef enum ReplayEventType
+{
+    RE_END,
+    RE_SPEED,
+    RE_COMMAND,
+
+    RE_EOL
+} ReplayEventType;
+
+typedef struct ReplayEvent
+{
+    unsigned int frame;
+    ReplayEventType type;
+    int speed; // RE_SPEED: frames per tick, SPEED_TURBO or REPLAY_PAUSED
+    SimCommand command; // RE_COMMAND
+    bool accepted; // RE_COMMAND: result of sim_applyCommand
+} ReplayEvent;
+
+// Recording buffer with a fixed size, nothing is allocated while recording. Once an
+// event does not fit the recording stops (full), the end still fits and is set to the
+// last event that made it in, so the replay stays valid up to there.
+typedef struct Replay
+{
+    unsigned char *data;
+    unsigned int len;
+    unsigned int size;
+    bool full;
+    unsigned int lastFrame; // of the last event written
+    int lastSpeed;
+    unsigned int commands; // recorded since replay_begin, counted even when full
+} Replay;
+
+typedef struct ReplayReader
+{
+    const Replay *replay;
+    unsigned int pos;
+    unsigned int frame; // of the last event read
+    int levelIndex; // of the start, -1: playground
+    bool error; // malformed data
+} ReplayReader;
+
+typedef enum ReplayStatus
+{
+    REPLAY_OK,
+    REPLAY_INVALID, // not a replay, malformed or for a level that does not exist
+    REPLAY_DIVERGED, // a command got another result than when recorded, the game played out differently
+} ReplayStatus;
+
+void replay_init(Replay *r, unsigned int size);
+void replay_free(Replay *r);
+
+// Starts a new recording of state at frame. levelIndex is the LEVELS entry the state
+// was loaded from, -1 for the playground (state_reset plus towers and rounding).
+void replay_begin(Replay *r, int levelIndex, const GameState *state, unsigned int frame);
+// cmd was applied with sim_applyCommand (result: accepted), frame is the frame before
+void replay_recordCommand(Replay *r, unsigned int frame, const SimCommand *cmd, bool accepted);
+// only written when speed changed since the last call
+void replay_recordSpeed(Replay *r, unsigned int frame, int speed);
+void replay_end(Replay *r, unsigned int frame);
+// Drops everything recorded after the first commands commands, e.g. when the game
+// rewinds to a state that had seen that many. Recording continues from there.
+void replay_truncate(Replay *r, unsigned int commands);
+
+// returns false if the file could not be written
+bool replay_save(const Replay *r, const char *filename);
+// Replaces the content of r (initialized with replay_init). Returns false if the file
+// could not be read or is bigger than r->size, a recording never is.
+bool replay_load(Replay *r, const char *filename);
+
+// Reads the start of r and sets state (initialized with state_init) and frame to it.
+// Returns false if r is not a replay of this version.
+bool replay_start(ReplayReader *reader, const Replay *r, GameState *state, unsigned int *frame);
+// returns false after RE_END or if the data is malformed (reader->error)
+bool replay_next(ReplayReader *reader, ReplayEvent *e);
+// Plays r from the start without rendering, as fast as level_advance goes. state is
+// then the state at the end of the recording, frame its frame and reader at the end.
+ReplayStatus replay_play(ReplayReader *reader, const Replay *r, GameState *state, unsigned int *frame);
+
+#endif // REPLAY_H
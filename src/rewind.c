@@ -0,0 +1,380 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rewind.h"
+
+// words of the structs stored as they are, all of them are made of 32 bit members
+#define HOME_WORDS (sizeof(Home) / 4)
+#define HASH_WORDS (sizeof(StateHash) / 4)
+#define TOWER_WORDS (sizeof(Tower) / 4)
+#define QUEUE_WORDS (sizeof(EnemyQueue) / 4)
+#define SHOT_WORDS (sizeof(Shot) / 4)
+#define MSG_WORDS (sizeof(SavedMessage) / 4)
+typedef char static_assert_home_words[(sizeof(Home) % 4 == 0) ? 1 : -1];
+typedef char static_assert_tower_words[(sizeof(Tower) % 4 == 0) ? 1 : -1];
+typedef char static_assert_shot_words[(sizeof(Shot) % 4 == 0) ? 1 : -1];
+typedef char static_assert_msg_words[(sizeof(SavedMessage) % 4 == 0) ? 1 : -1];
+
+#define SCALAR_WORDS 10
+#define SLOT_FIELDS 8 // per handle slot: list index + 1 (0: free), generation, x, y, speedX, speedY, health, towersHit
+#define REWIND_IMAGE_WORDS (HOME_WORDS + HASH_WORDS + SCALAR_WORDS \
+    + MAX_TOWERS * TOWER_WORDS + 2 * MAX_TOWERS \
+    + SLOT_FIELDS * MAX_ENEMIES + MAX_ENEMIES / 32 + MAX_ENEMIES \
+    + QUEUE_SIZE * QUEUE_WORDS + MAX_SIMUL_SHOTS * SHOT_WORDS + SAVED_MSGS_MAX * MSG_WORDS)
+// every word a 5 byte varint, plus at most a byte per word for the runs
+#define REWIND_DELTA_MAX (6 * REWIND_IMAGE_WORDS + 16)
+
+#define SLOT_MASK ((1u << ENEMY_HANDLE_SLOT_BITS) - 1)
+
+void rewind_init(Rewind *r, unsigned int size, unsigned int interval)
+{
+    *r = (Rewind){ .size = size, .interval = interval, .shownIndex = -1 };
+    r->data = calloc(size, 1);
+    r->snapshots = calloc(REWIND_SNAPSHOTS_MAX, sizeof(r->snapshots[0]));
+    r->newest = calloc(REWIND_IMAGE_WORDS, sizeof(unsigned int));
+    r->shown = calloc(REWIND_IMAGE_WORDS, sizeof(unsigned int));
+    r->image = calloc(REWIND_IMAGE_WORDS, sizeof(unsigned int));
+    r->encoded = calloc(REWIND_DELTA_MAX, 1);
+}
+
+void rewind_free(Rewind *r)
+{
+    free(r->data);
+    free(r->snapshots);
+    free(r->newest);
+    free(r->shown);
+    free(r->image);
+    free(r->encoded);
+    *r = (Rewind){ 0 };
+}
+
+void rewind_clear(Rewind *r)
+{
+    r->head = 0;
+    r->used = 0;
+    r->first = 0;
+    r->count = 0;
+    r->shownIndex = -1;
+}
+
+unsigned int rewind_memory(const Rewind *r)
+{
+    return r->size + REWIND_SNAPSHOTS_MAX * sizeof(r->snapshots[0])
+        + 3 * REWIND_IMAGE_WORDS * sizeof(unsigned int) + REWIND_DELTA_MAX;
+}
+
+static RewindSnapshot *snapshot_at(const Rewind *r, unsigned int index)
+{
+    return r->snapshots + (r->first + index) % REWIND_SNAPSHOTS_MAX;
+}
+
+const RewindSnapshot *rewind_snapshot(const Rewind *r, int index)
+{
+    if (index < 0 || index >= (int)r->count)
+        return NULL;
+    return snapshot_at(r, index);
+}
+
+static unsigned int *image_put(unsigned int *w, const void *src, unsigned int words)
+{
+    memcpy(w, src, words * 4);
+    return w + words;
+}
+
+static const unsigned int *image_get(const unsigned int *w, void *dst, unsigned int words)
+{
+    memcpy(dst, w, words * 4);
+    return w + words;
+}
+
+static void image_write(unsigned int *image, const GameState *s)
+{
+    const EnemyList *e = &s->enemies;
+    unsigned int *w = image;
+    w = image_put(w, &s->home, HOME_WORDS);
+    w = image_put(w, &s->hash, HASH_WORDS);
+    *w++ = s->towerLen;
+    *w++ = s->schedule.waitingLen;
+    *w++ = s->schedule.readyLen;
+    *w++ = s->enemiesLen;
+    *w++ = e->freeSlotsLen;
+    *w++ = s->queueHead;
+    *w++ = s->queueTail;
+    *w++ = s->shotHead;
+    *w++ = s->shotTail;
+    *w++ = s->msgIndex;
+
+    // unused entries are zero, so the image only depends on the state and not on the
+    // stale data a GameState keeps around
+    memset(w, 0, (MAX_TOWERS * TOWER_WORDS + 2 * MAX_TOWERS) * 4);
+    image_put(w, s->towers, s->towerLen * TOWER_WORDS);
+    w += MAX_TOWERS * TOWER_WORDS;
+    image_put(w, s->schedule.waiting, s->schedule.waitingLen);
+    w += MAX_TOWERS;
+    image_put(w, s->schedule.ready, s->schedule.readyLen);
+    w += MAX_TOWERS;
+
+    unsigned int *slotIndex = w;
+    w = image_put(w + MAX_ENEMIES, e->slotGeneration, MAX_ENEMIES);
+    float *fields[5];
+    for (int f = 0; f < 5; ++f)
+        fields[f] = (float *)w + f * MAX_ENEMIES;
+    unsigned int *towersHit = w + 5 * MAX_ENEMIES;
+    memset(slotIndex, 0, MAX_ENEMIES * 4);
+    memset(w, 0, 6 * MAX_ENEMIES * 4);
+    for (unsigned int i = 0; i < s->enemiesLen; ++i)
+    {
+        unsigned int slot = e->handle[i] & SLOT_MASK;
+        slotIndex[slot] = i + 1;
+        fields[0][slot] = e->x[i];
+        fields[1][slot] = e->y[i];
+        fields[2][slot] = e->speedX[i];
+        fields[3][slot] = e->speedY[i];
+        fields[4][slot] = e->health[i];
+        towersHit[slot] = e->towersHit[i];
+    }
+    w += 6 * MAX_ENEMIES;
+    w = image_put(w, e->alive, MAX_ENEMIES / 32);
+    memset(w, 0, MAX_ENEMIES * 4);
+    image_put(w, e->freeSlots, e->freeSlotsLen);
+    w += MAX_ENEMIES;
+
+    w = image_put(w, s->queue, QUEUE_SIZE * QUEUE_WORDS);
+    w = image_put(w, s->shots, MAX_SIMUL_SHOTS * SHOT_WORDS);
+    w = image_put(w, s->msg, SAVED_MSGS_MAX * MSG_WORDS);
+}
+
+static void image_read(const unsigned int *image, GameState *s)
+{
+    EnemyList *e = &s->enemies;
+    const unsigned int *w = image;
+    w = image_get(w, &s->home, HOME_WORDS);
+    w = image_get(w, &s->hash, HASH_WORDS);
+    s->towerLen = *w++;
+    s->schedule.waitingLen = *w++;
+    s->schedule.readyLen = *w++;
+    s->enemiesLen = *w++;
+    e->freeSlotsLen = *w++;
+    s->queueHead = *w++;
+    s->queueTail = *w++;
+    s->shotHead = *w++;
+    s->shotTail = *w++;
+    s->msgIndex = *w++;
+
+    image_get(w, s->towers, s->towerLen * TOWER_WORDS);
+    w += MAX_TOWERS * TOWER_WORDS;
+    image_get(w, s->schedule.waiting, s->schedule.waitingLen);
+    w += MAX_TOWERS;
+    image_get(w, s->schedule.ready, s->schedule.readyLen);
+    w += MAX_TOWERS;
+
+    const unsigned int *slotIndex = w;
+    w = image_get(w + MAX_ENEMIES, e->slotGeneration, MAX_ENEMIES);
+    const float *fields[5];
+    for (int f = 0; f < 5; ++f)
+        fields[f] = (const float *)w + f * MAX_ENEMIES;
+    const unsigned int *towersHit = w + 5 * MAX_ENEMIES;
+    for (unsigned int slot = 0; slot < MAX_ENEMIES; ++slot)
+    {
+        if (slotIndex[slot] == 0)
+            continue;
+        unsigned int i = slotIndex[slot] - 1;
+        e->slotIndex[slot] = i;
+        e->handle[i] = e->slotGeneration[slot] << ENEMY_HANDLE_SLOT_BITS | slot;
+        e->x[i] = fields[0][slot];
+        e->y[i] = fields[1][slot];
+        e->speedX[i] = fields[2][slot];
+        e->speedY[i] = fields[3][slot];
+        e->health[i] = fields[4][slot];
+        e->towersHit[i] = towersHit[slot];
+    }
+    w += 6 * MAX_ENEMIES;
+    w = image_get(w, e->alive, MAX_ENEMIES / 32);
+    image_get(w, e->freeSlots, e->freeSlotsLen);
+    w += MAX_ENEMIES;
+
+    w = image_get(w, s->queue, QUEUE_SIZE * QUEUE_WORDS);
+    w = image_get(w, s->shots, MAX_SIMUL_SHOTS * SHOT_WORDS);
+    w = image_get(w, s->msg, SAVED_MSGS_MAX * MSG_WORDS);
+}
+
+static unsigned char *put_uint(unsigned char *p, unsigned int x)
+{
+    while (x >= 0x80)
+    {
+        *p++ = (unsigned char)(x | 0x80);
+        x >>= 7;
+    }
+    *p++ = (unsigned char)x;
+    return p;
+}
+
+static const unsigned char *get_uint(const unsigned char *p, unsigned int *x)
+{
+    unsigned int value = 0;
+    for (int shift = 0; ; shift += 7)
+    {
+        unsigned char byte = *p++;
+        value |= (unsigned int)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            break;
+    }
+    *x = value;
+    return p;
+}
+
+// runs of (unchanged words, changed words, zigzagged differences to, minus from)
+static unsigned int delta_encode(unsigned char *out, const unsigned int *from, const unsigned int *to)
+{
+    unsigned char *p = out;
+    unsigned int i = 0;
+    while (i < REWIND_IMAGE_WORDS)
+    {
+        unsigned int start = i;
+        while (i < REWIND_IMAGE_WORDS && from[i] == to[i])
+            ++i;
+        unsigned int changed = i;
+        while (changed < REWIND_IMAGE_WORDS && from[changed] != to[changed])
+            ++changed;
+        p = put_uint(p, i - start);
+        p = put_uint(p, changed - i);
+        for (; i < changed; ++i)
+        {
+            int d = (int)(to[i] - from[i]);
+            p = put_uint(p, ((unsigned int)d << 1) ^ (unsigned int)(d >> 31));
+        }
+    }
+    return (unsigned int)(p - out);
+}
+
+// adds (forward) or subtracts the differences of a delta to image
+static void delta_apply(unsigned int *image, const unsigned char *p, unsigned int len, bool forward)
+{
+    const unsigned char *end = p + len;
+    unsigned int i = 0;
+    while (p < end)
+    {
+        unsigned int unchanged, changed;
+        p = get_uint(p, &unchanged);
+        p = get_uint(p, &changed);
+        i += unchanged;
+        for (unsigned int n = 0; n < changed; ++n, ++i)
+        {
+            unsigned int z;
+            p = get_uint(p, &z);
+            unsigned int d = (z >> 1) ^ -(z & 1);
+            image[i] = forward ? image[i] + d : image[i] - d;
+        }
+    }
+}
+
+// copies the delta of snapshot to encoded, it may wrap around the end of the ring
+static const unsigned char *delta_fetch(Rewind *r, const RewindSnapshot *snap)
+{
+    unsigned int tail = r->size - snap->offset;
+    if (snap->len <= tail)
+        return r->data + snap->offset;
+    memcpy(r->encoded, r->data + snap->offset, tail);
+    memcpy(r->encoded + tail, r->data, snap->len - tail);
+    return r->encoded;
+}
+
+static void dropOldest(Rewind *r)
+{
+    RewindSnapshot *oldest = snapshot_at(r, 0);
+    r->used -= oldest->len;
+    r->first = (r->first + 1) % REWIND_SNAPSHOTS_MAX;
+    --r->count;
+}
+
+void rewind_capture(Rewind *r, const GameState *state, unsigned int frame, unsigned int tag)
+{
+    if (r->count > 0)
+    {
+        RewindSnapshot *newest = snapshot_at(r, r->count - 1);
+        if (newest->frame == frame && newest->tag == tag)
+            return;
+
+        image_write(r->image, state);
+        unsigned int len = delta_encode(r->encoded, r->newest, r->image);
+        if (len > r->size)
+        {
+            rewind_clear(r);
+        }
+        else
+        {
+            // the newest snapshot has no delta, it is never dropped here
+            while (r->count > 1 && (r->used + len > r->size || r->count >= REWIND_SNAPSHOTS_MAX))
+                dropOldest(r);
+            newest = snapshot_at(r, r->count - 1);
+            newest->offset = r->head;
+            newest->len = len;
+            unsigned int tail = r->size - r->head;
+            memcpy(r->data + r->head, r->encoded, MIN(len, tail));
+            if (len > tail)
+                memcpy(r->data, r->encoded + tail, len - tail);
+            r->head = (r->head + len) % r->size;
+            r->used += len;
+        }
+        unsigned int *swap = r->newest;
+        r->newest = r->image;
+        r->image = swap;
+    }
+    else
+    {
+        image_write(r->newest, state);
+    }
+
+    *snapshot_at(r, r->count++) = (RewindSnapshot){ .frame = frame, .tag = tag, .offset = r->head };
+    r->shownIndex = -1;
+}
+
+void rewind_update(Rewind *r, const GameState *state, unsigned int frame, unsigned int tag)
+{
+    if (r->count > 0 && frame - snapshot_at(r, r->count - 1)->frame < r->interval)
+        return;
+    rewind_capture(r, state, frame, tag);
+}
+
+// steps the shown image to snapshot index
+static void rewind_show(Rewind *r, int index)
+{
+    if (r->shownIndex < 0)
+    {
+        memcpy(r->shown, r->newest, REWIND_IMAGE_WORDS * sizeof(unsigned int));
+        r->shownIndex = r->count - 1;
+    }
+    while (r->shownIndex > index)
+    {
+        const RewindSnapshot *snap = snapshot_at(r, --r->shownIndex);
+        delta_apply(r->shown, delta_fetch(r, snap), snap->len, false);
+    }
+    while (r->shownIndex < index)
+    {
+        const RewindSnapshot *snap = snapshot_at(r, r->shownIndex++);
+        delta_apply(r->shown, delta_fetch(r, snap), snap->len, true);
+    }
+}
+
+bool rewind_restore(Rewind *r, int index, GameState *state)
+{
+    if (index < 0 || index >= (int)r->count)
+        return false;
+    rewind_show(r, index);
+    image_read(r->shown, state);
+    return true;
+}
+
+void rewind_truncate(Rewind *r, int index)
+{
+    if (index < 0 || index >= (int)r->count - 1)
+        return;
+    rewind_show(r, index);
+    memcpy(r->newest, r->shown, REWIND_IMAGE_WORDS * sizeof(unsigned int));
+    while ((int)r->count > index + 1)
+        r->used -= snapshot_at(r, --r->count)->len;
+    RewindSnapshot *newest = snapshot_at(r, index);
+    r->used -= newest->len;
+    r->head = newest->offset;
+    newest->len = 0;
+}
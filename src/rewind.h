@@ -0,0 +1,80 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+// Rewind: snapshots of the simulation state every REWIND_INTERVAL_DEFAULT frames,
+// kept in a byte ring of fixed size. Only the newest snapshot is stored whole, every
+// older one is the difference to the snapshot after it, so stepping one snapshot back
+// or forth is a single delta applied to the last one shown, however far back it is.
+// Once the ring is full the oldest snapshots are dropped.
+//
+// A snapshot is the state as a flat array of 32 bit words (REWIND_IMAGE_WORDS in rewind.c), the
+// delta is the difference of each word to the same word of the next snapshot, as runs
+// of unchanged words and varints of the zigzagged differences of the others. Enemies
+// are stored by handle slot, not by list index, so an enemy keeps its words while the
+// ones before it die, and a moving enemy only differs in the low bits of its x. Placed
+// towers, the queue and the handle bookkeeping rarely change and cost a run each.
+//
+// Memory is fixed when initialized and nothing is allocated afterwards: the ring,
+// three state images (newest, shown, scratch), one encoded delta and the snapshot
+// entries, see rewind_memory. With the defaults that is 1 MB + 3 x 40 KB + 60 KB +
+// 64 KB, about 1.3 MB. A shipped level takes under 100 bytes per snapshot, which keeps
+// over an hour of game time, a full screen of enemies (bench max_towers_enemies)
+// about 4 KB, two minutes. bench prints the numbers per scenario.
+//
+// The grid and the health cache of a GameState are not part of a snapshot, the grid is
+// rebuilt by level_logic and the cache only speeds things up.
+
+#include "sim.h"
+
+#define REWIND_SIZE_DEFAULT (1024 * 1024) // bytes for the deltas
+#define REWIND_INTERVAL_DEFAULT 30 // frames between snapshots
+#define REWIND_SNAPSHOTS_MAX 4096
+
+typedef struct RewindSnapshot
+{
+    unsigned int frame;
+    unsigned int tag; // set by the caller, e.g. the number of commands recorded so far
+    unsigned int offset; // of the delta to the next snapshot in Rewind.data
+    unsigned int len; // 0 for the newest
+} RewindSnapshot;
+
+typedef struct Rewind
+{
+    unsigned char *data; // ring of deltas
+    unsigned int size;
+    unsigned int head; // where the next delta is written
+    unsigned int used;
+    unsigned int interval;
+
+    RewindSnapshot *snapshots; // ring of REWIND_SNAPSHOTS_MAX, oldest at first
+    unsigned int first;
+    unsigned int count;
+
+    unsigned int *newest; // image of the newest snapshot
+    unsigned int *shown; // image of snapshot shownIndex, stepped by rewind_restore
+    int shownIndex; // -1: not set up since the last change
+    unsigned int *image; // scratch
+    unsigned char *encoded; // scratch for one delta
+} Rewind;
+
+void rewind_init(Rewind *r, unsigned int size, unsigned int interval);
+void rewind_free(Rewind *r);
+// drops all snapshots
+void rewind_clear(Rewind *r);
+// bytes allocated by rewind_init
+unsigned int rewind_memory(const Rewind *r);
+
+// Takes a snapshot of state if interval frames passed since the newest one (or the
+// frame went back, e.g. after a restart). Call once per frame after the logic.
+void rewind_update(Rewind *r, const GameState *state, unsigned int frame, unsigned int tag);
+// takes a snapshot of state now, unless the newest one has the same frame and tag
+void rewind_capture(Rewind *r, const GameState *state, unsigned int frame, unsigned int tag);
+// index 0 is the oldest snapshot, count - 1 the newest
+const RewindSnapshot *rewind_snapshot(const Rewind *r, int index);
+// Sets state (initialized with state_init) to snapshot index. Cheapest when index is
+// next to the snapshot restored last. Returns false if there is no such snapshot.
+bool rewind_restore(Rewind *r, int index, GameState *state);
+// drops the snapshots after index, index becomes the newest
+void rewind_truncate(Rewind *r, int index);
+
+#endif // REWIND_H
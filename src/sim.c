@@ -0,0 +1,1083 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <limits.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "sim.h"
+#include "sim_simd.h"
+#include "thread.h"
+
+#define DEG2RAD_F (3.14159265358979323846f / 180.0f)
+
+const char *EQUATION_NAMES[ET_EOL] = {
+    "none", "add", "sub", "mult", "div", "sqr", "sqrt", "log_e", "log_2", "log_10", "round", "sin", "cos", "tan",
+};
+
+const char *HASH_FIELD_NAMES[HF_EOL] = {
+    "enemy_pos", "enemy_health", "enemy_alive", "towers", "queue", "home",
+};
+
+static volatile int allocations = 0;
+
+static void *sim_calloc(size_t count, size_t size)
+{
+    atomic_add(&allocations, 1);
+    return calloc(count, size);
+}
+
+int sim_allocationCount(void)
+{
+    return atomic_get(&allocations);
+}
+
+typedef char static_assert_max_towers[(MAX_TOWERS <= 32) ? 1 : -1];
+
+static unsigned int handle_slot(EnemyHandle h)
+{
+    return h & ((1u << ENEMY_HANDLE_SLOT_BITS) - 1);
+}
+
+unsigned int sim_hashMix(unsigned int h, unsigned int value)
+{
+    // the added constant keeps mixing 0 into 0 from giving 0
+    unsigned int x = ((h ^ value) + 0x7F4A7C15u) * 0x9E3779B1u;
+    return x ^ (x >> 16);
+}
+
+static void hash_mix(StateHash *h, HashField field, unsigned int value)
+{
+    h->field[field] = sim_hashMix(h->field[field], value);
+}
+
+static void hash_mixFloat(StateHash *h, HashField field, float value)
+{
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    hash_mix(h, field, bits);
+}
+
+unsigned int state_hash(const GameState *state)
+{
+    StateHash h = { 0 };
+    for (int f = 0; f < HF_EOL; ++f)
+        hash_mix(&h, 0, state->hash.field[f]);
+    return h.field[0];
+}
+
+static void enemies_releaseSlot(EnemyList *e, unsigned int slot)
+{
+    // generation 0 is skipped, so ENEMY_HANDLE_NONE is never a valid handle
+    unsigned int generation = (e->slotGeneration[slot] + 1) & ((1u << (32 - ENEMY_HANDLE_SLOT_BITS)) - 1);
+    e->slotGeneration[slot] = generation == 0 ? 1 : generation;
+    e->freeSlots[e->freeSlotsLen++] = slot;
+}
+
+// invalidates all handles
+static void enemies_releaseAll(EnemyList *e)
+{
+    e->freeSlotsLen = 0;
+    for (int slot = MAX_ENEMIES - 1; slot >= 0; --slot)
+        enemies_releaseSlot(e, slot);
+}
+
+static EnemyHandle enemies_allocHandle(EnemyList *e, unsigned int index)
+{
+    assert(e->freeSlotsLen > 0);
+    unsigned int slot = e->freeSlots[--e->freeSlotsLen];
+    e->slotIndex[slot] = index;
+    return e->slotGeneration[slot] << ENEMY_HANDLE_SLOT_BITS | slot;
+}
+
+// removes dead enemies, keeping the others in order
+static void enemies_compact(EnemyList *e, unsigned int *len)
+{
+    unsigned int out = 0;
+    for (unsigned int i = 0; i < *len; ++i)
+    {
+        EnemyHandle h = e->handle[i];
+        unsigned int slot = h & ((1u << ENEMY_HANDLE_SLOT_BITS) - 1);
+        if (!enemy_isAlive(e, i))
+        {
+            enemies_releaseSlot(e, slot);
+            continue;
+        }
+
+        if (out != i)
+        {
+            e->x[out] = e->x[i];
+            e->y[out] = e->y[i];
+            e->speedX[out] = e->speedX[i];
+            e->speedY[out] = e->speedY[i];
+            e->health[out] = e->health[i];
+            e->towersHit[out] = e->towersHit[i];
+            e->handle[out] = h;
+            e->slotIndex[slot] = out;
+        }
+        ++out;
+    }
+
+    unsigned int words = (*len + 31) / 32;
+    for (unsigned int w = 0; w < words; ++w)
+    {
+        if (out >= (w + 1) * 32)
+            e->alive[w] = ~0u;
+        else if (out > w * 32)
+            e->alive[w] = (1u << (out - w * 32)) - 1;
+        else
+            e->alive[w] = 0;
+    }
+    *len = out;
+}
+
+// Places the arrays of s in block, NULL only measures. Returns the bytes needed, the
+// arrays before the grid are the state and end at copyBytes (the grid is scratch).
+static size_t state_layout(GameState *s, unsigned char *block, size_t *copyBytes)
+{
+    size_t used = 0;
+    // every array starts on a cache line
+#define STATE_TAKE(array, count) \
+    do { \
+        if (block) \
+            (array) = (void *)(block + used); \
+        used += ((count) * sizeof(*(array)) + 63) & ~(size_t)63; \
+    } while (0)
+
+    STATE_TAKE(s->towers, MAX_TOWERS);
+    STATE_TAKE(s->schedule.waiting, MAX_TOWERS);
+    STATE_TAKE(s->schedule.ready, MAX_TOWERS);
+
+    STATE_TAKE(s->enemies.x, MAX_ENEMIES);
+    STATE_TAKE(s->enemies.y, MAX_ENEMIES);
+    STATE_TAKE(s->enemies.speedX, MAX_ENEMIES);
+    STATE_TAKE(s->enemies.speedY, MAX_ENEMIES);
+    STATE_TAKE(s->enemies.health, MAX_ENEMIES);
+    STATE_TAKE(s->enemies.alive, MAX_ENEMIES / 32);
+    STATE_TAKE(s->enemies.towersHit, MAX_ENEMIES);
+    STATE_TAKE(s->enemies.handle, MAX_ENEMIES);
+    STATE_TAKE(s->enemies.slotIndex, MAX_ENEMIES);
+    STATE_TAKE(s->enemies.slotGeneration, MAX_ENEMIES);
+    STATE_TAKE(s->enemies.freeSlots, MAX_ENEMIES);
+
+    STATE_TAKE(s->queue, QUEUE_SIZE);
+    // rolling buffer, we do not check for overwrites, so this has to be big enough
+    // Equal to max towers, because every tower can only shoot once simultaniously
+    STATE_TAKE(s->shots, MAX_SIMUL_SHOTS);
+    STATE_TAKE(s->msg, SAVED_MSGS_MAX);
+    *copyBytes = used;
+
+    STATE_TAKE(s->grid.cellStart, GRID_CELLS + 1);
+    STATE_TAKE(s->grid.items, MAX_ENEMIES);
+    STATE_TAKE(s->grid.candidates, MAX_ENEMIES / 32);
+    STATE_TAKE(s->grid.live, MAX_ENEMIES / 32);
+#undef STATE_TAKE
+    return used;
+}
+
+void state_init(GameState *s)
+{
+    s->home = (Home){
+        .rect = {HOME_TILE_X * TOWER_SIZE, PATH_TILE_Y * TOWER_SIZE, TOWER_SIZE, TOWER_SIZE},
+        .health = 10,
+        .allowedTowers = -1, // all by default
+    };
+
+    size_t copyBytes;
+    size_t size = state_layout(s, NULL, &copyBytes);
+    s->block = sim_calloc(size, 1);
+    s->blockCopyBytes = copyBytes;
+    state_layout(s, s->block, &copyBytes);
+
+    s->towerLen = 0;
+    s->schedule.waitingLen = 0;
+    s->schedule.readyLen = 0;
+    s->enemiesLen = 0;
+    enemies_releaseAll(&s->enemies);
+    s->queueHead = 0;
+    s->queueTail = 0;
+    s->shotHead = 0;
+    s->shotTail = 0;
+    s->msgIndex = 0;
+    s->grid.itemsLen = 0;
+
+    s->healthCache = NULL;
+    s->hash = (StateHash){ 0 };
+}
+
+void state_free(GameState *s)
+{
+    free(s->block);
+    s->block = NULL;
+}
+
+void state_reset(GameState *s)
+{
+    s->towerLen = 0;
+    s->schedule.waitingLen = 0;
+    s->schedule.readyLen = 0;
+    s->home.health = HEALTH_DEFAULT;
+    s->home.score = 0;
+    s->enemiesLen = 0;
+    memset(s->enemies.alive, 0, MAX_ENEMIES / 32 * sizeof(unsigned int));
+    enemies_releaseAll(&s->enemies);
+    s->queueHead = s->queueTail = 0;
+    s->shotHead = s->shotTail = 0;
+    s->msgIndex = 0;
+    s->hash = (StateHash){ 0 };
+}
+
+void state_addTower(GameState *s, int tileX, int tileY, int type, int scale)
+{
+    s->towers[s->towerLen++] = (Tower){
+        .rect = {tileX * TOWER_SIZE, tileY * TOWER_SIZE, TOWER_SIZE, TOWER_SIZE},
+        .center = {(tileX + 0.5) * TOWER_SIZE, (tileY + 0.5) * TOWER_SIZE},
+        .type = type,
+        .scale = scale,
+        .range = TOWER_RANGE,
+        .cooldown = 60,
+    };
+    // checked against its cooldown on first use
+    s->schedule.ready[s->schedule.readyLen++] = s->towerLen - 1;
+    hash_mix(&s->hash, HF_TOWERS, tileX);
+    hash_mix(&s->hash, HF_TOWERS, tileY);
+    hash_mix(&s->hash, HF_TOWERS, type);
+    hash_mix(&s->hash, HF_TOWERS, scale);
+}
+
+bool state_addQueueFromString(GameState *s, unsigned int startFrame, const char *queue, unsigned int count, unsigned int spacing)
+{
+    unsigned int spawnFrame;
+    if (s->queueHead == s->queueTail) // queue is empty -> spawn immediately
+        spawnFrame = startFrame;
+    else
+        spawnFrame = s->queue[(s->queueHead - 1) % QUEUE_SIZE].spawnFrame + spacing;
+
+    while (count > 0)
+    {
+        // entries are separated by , or ; (empty entries are skipped), atof stops at either
+        for (const char *pos = queue + strspn(queue, ",;"); *pos != 0; pos += strspn(pos, ",;"))
+        {
+            bool queueIsFull = (s->queueHead - s->queueTail >= QUEUE_SIZE);
+            if (queueIsFull)
+                return false;
+
+            float value = atof(pos);
+            pos += strcspn(pos, ",;");
+            if (value == 0 || !isfinite(value))
+                continue;
+
+            s->queue[s->queueHead % QUEUE_SIZE] = (EnemyQueue){
+                .spawnFrame = spawnFrame,
+                .health = value,
+            };
+            ++s->queueHead;
+            hash_mix(&s->hash, HF_QUEUE, spawnFrame);
+            hash_mixFloat(&s->hash, HF_QUEUE, value);
+            spawnFrame += spacing;
+        }
+
+        --count;
+    }
+
+    return true;
+}
+
+void state_loadFromLevelDef(GameState *state, LevelDef l, int index)
+{
+    state_addQueueFromString(state, 0, l.health, l.count, l.spacing);
+    state->home.allowedTowers = l.towersAllowed;
+    state->home.minTowers = l.minSolution;
+    state->home.roundingFactor = l.roundingFactor;
+    state->home.levelIndex = index;
+    hash_mix(&state->hash, HF_HOME, index);
+}
+
+void state_copy(GameState *dst, const GameState *src)
+{
+    // the arrays sit at the same offsets in every block
+    memcpy(dst->block, src->block, src->blockCopyBytes);
+
+    dst->home = src->home;
+    dst->towerLen = src->towerLen;
+    dst->schedule.waitingLen = src->schedule.waitingLen;
+    dst->schedule.readyLen = src->schedule.readyLen;
+    dst->enemiesLen = src->enemiesLen;
+    dst->enemies.freeSlotsLen = src->enemies.freeSlotsLen;
+    dst->queueHead = src->queueHead;
+    dst->queueTail = src->queueTail;
+    dst->shotHead = src->shotHead;
+    dst->shotTail = src->shotTail;
+    dst->msgIndex = src->msgIndex;
+    dst->hash = src->hash;
+
+    // the grid is rebuilt at the start of every frame, nothing to copy
+}
+
+bool sim_applyCommand(GameState *state, unsigned int *frame, const SimCommand *cmd)
+{
+    switch (cmd->type)
+    {
+        case CMD_ADD_TOWER:
+        {
+            if (state->towerLen >= MAX_TOWERS || cmd->tower <= ET_NONE || cmd->tower >= ET_EOL)
+                return false;
+            // the caller may have checked against an older state
+            for (int i = 0; i < state->towerLen; ++i)
+            {
+                if (state->towers[i].rect.x == cmd->tileX * TOWER_SIZE && state->towers[i].rect.y == cmd->tileY * TOWER_SIZE)
+                    return false;
+            }
+            state_addTower(state, cmd->tileX, cmd->tileY, cmd->tower, cmd->scale);
+            return true;
+        }
+        case CMD_ADD_QUEUE:
+            return state_addQueueFromString(state, *frame, cmd->health, cmd->count, cmd->spacing);
+        case CMD_RESET:
+            state_reset(state);
+            return true;
+        case CMD_LOAD_LEVEL:
+            state_reset(state);
+            state_loadFromLevelDef(state, cmd->level, cmd->levelIndex);
+            *frame = 0;
+            return true;
+        case CMD_SET_ROUNDING:
+            state->home.roundingFactor = cmd->roundingFactor;
+            hash_mix(&state->hash, HF_HOME, cmd->roundingFactor);
+            return true;
+        default:
+            printf("ERROR: Unknown sim command: %d\n", cmd->type);
+            return false;
+    }
+}
+
+bool state_isOver(const GameState *state)
+{
+    return (state->queueHead == state->queueTail && state->enemiesLen == 0) || state->home.health <= 0;
+}
+
+int state_score(const GameState *state)
+{
+    if (state->queueHead != state->queueTail || state->enemiesLen > 0)
+        return 0;
+    if (state->home.health != HEALTH_DEFAULT)
+        return 1;
+    if (state->towerLen < state->home.minTowers)
+        return 4;
+    if (state->towerLen == state->home.minTowers)
+        return 3;
+    return 2;
+}
+
+bool canTarget(EquationType tower, float health)
+{
+    switch (tower)
+    {
+        case ET_ADD:
+        case ET_SUB:
+        case ET_MULT:
+        case ET_DIV:
+        case ET_SQR:
+        case ET_ROUND:
+        case ET_SIN:
+        case ET_COS:
+            return true;
+        case ET_SQRT:
+        case ET_LOG_E:
+        case ET_LOG_2:
+        case ET_LOG_10:
+            return health > 0;
+        case ET_TAN:
+            if (fabsf(health - (int)health) > FLT_EPSILON)
+                return true;
+            return ((int)health % 90 != 0) || ((int)health % 180 == 0);
+        default:
+            printf("ERROR: Type of tower unknown: %d\n", tower);
+            assert(false); // always assert
+    }
+    return false;
+}
+
+int defaultTowerScale(EquationType type)
+{
+    return (type == ET_MULT || type == ET_DIV) ? 2 : 1;
+}
+
+bool sim_canPlaceTile(int tileX, int tileY)
+{
+    if (tileX < 0 || tileX >= FIELD_WIDTH / TOWER_SIZE || tileY <= 0 || tileY >= FIELD_HEIGHT / TOWER_SIZE - 1)
+        return false;
+    // the tiles left of home are free
+    return tileY != PATH_TILE_Y || tileX < HOME_TILE_X;
+}
+
+TakeHealthResult takeHealth(float *health, const Tower *t, int rounding)
+{
+    return sim_applyOp(health, t->type, t->scale, rounding);
+}
+
+bool sim_applyOpFixed(float *health, EquationType type, int scale, int rounding, TakeHealthResult *result)
+{
+    if (rounding < 1 || rounding > HEALTH_FIXED_MAX_ROUNDING || type < ET_ADD || type > ET_SQR)
+        return false;
+    float h = *health;
+    float scaled = h * rounding;
+    if (!(fabsf(scaled) < HEALTH_FIXED_LIMIT)) // also nan, inf
+        return false;
+    // the grid test below catches anything this rounds wrong (it is no roundf call)
+    long long steps = (long long)(scaled + (scaled < 0 ? -0.5f : 0.5f));
+    // off the grid, e.g. a level string with more digits
+    if ((rounding == 1) ? (float)steps != h : (float)steps / rounding != h)
+        return false;
+
+    // the exact result is num / den steps
+    long long num = steps;
+    long long den = 1;
+    switch (type)
+    {
+        case ET_ADD: num = steps + (long long)scale * rounding; break;
+        case ET_SUB: num = steps - (long long)scale * rounding; break;
+        case ET_MULT: num = steps * scale; break;
+        case ET_DIV: den = scale; break;
+        default: num = steps * steps; den = rounding; break; // (steps / rounding)² in steps
+    }
+    if (den == 0)
+        return false;
+    if (den < 0)
+    {
+        num = -num;
+        den = -den;
+    }
+    long long mag = num < 0 ? -num : num;
+    long long rounded = (den == 1) ? mag : (mag * 2 + den) / (den * 2);
+    if (rounded >= HEALTH_FIXED_LIMIT)
+        return false;
+
+    float value = num < 0 ? -(float)rounded : (float)rounded; // -0 like the float math
+    *health = (rounding == 1) ? value : value / rounding;
+    if (rounded == 0)
+        *result = TH_DEAD;
+    else if (mag < den)
+        *result = TH_SAVED_BY_ROUNDING; // less than a step, truncating would have killed it
+    else
+        *result = TH_ALIVE;
+    return true;
+}
+
+TakeHealthResult sim_applyOp(float *health, EquationType type, int scale, int rounding)
+{
+    float h = *health;
+    switch (type)
+    {
+        case ET_ADD: h += scale; break;
+        case ET_SUB: h -= scale; break;
+        case ET_MULT: h *= scale; break;
+        case ET_DIV: h /= scale; break;
+        case ET_SQR: h = h * h; break;
+        case ET_SQRT: h = sqrtf(h); break;
+        case ET_LOG_E: h = logf(h); break;
+        case ET_LOG_2: h = log2f(h); break;
+        case ET_LOG_10: h = log10f(h); break;
+        case ET_ROUND: h = roundf(h * powf(10, scale - 1)) / powf(10, scale - 1); break;
+        case ET_SIN: h = sinf(DEG2RAD_F * h); break;
+        case ET_COS: h = cosf(DEG2RAD_F * h); break;
+        case ET_TAN: h = tanf(DEG2RAD_F * h); break;
+        default:
+            printf("ERROR: Type of tower unknown: %d\n", type);
+            assert(false);
+    }
+    float healthNotRounded = 0;
+    if (rounding > 0)
+    {
+        healthNotRounded = (float)(int)(h * rounding) / rounding;
+        h = roundf(h * rounding) / rounding;
+    }
+    *health = h;
+
+    if (fabs(h) < FLT_EPSILON)
+    {
+        return TH_DEAD;
+    }
+    if (rounding > 0 && fabs(healthNotRounded) < FLT_EPSILON)
+    {
+        return TH_SAVED_BY_ROUNDING;
+    }
+    return TH_ALIVE;
+}
+
+void cache_init(HealthCache *c, int bits)
+{
+    *c = (HealthCache){ .mask = (1u << bits) - 1 };
+    c->entries = sim_calloc(1u << bits, sizeof(HealthCacheEntry));
+}
+
+void cache_free(HealthCache *c)
+{
+    free(c->entries);
+    c->entries = NULL;
+}
+
+TakeHealthResult cache_applyOp(HealthCache *c, float *health, EquationType type, int scale, int rounding)
+{
+    // plain arithmetic is cheaper than the lookup
+    if (type <= ET_SQR || scale < 0 || scale > USHRT_MAX)
+        return sim_applyOp(health, type, scale, rounding);
+
+    unsigned int bits;
+    memcpy(&bits, health, sizeof(bits));
+    unsigned int hash = (bits * 0x9E3779B1u) ^ (type * 0x85EBCA77u) ^ (scale * 0xC2B2AE3Du) ^ (rounding * 0x27D4EB2Fu);
+    hash ^= hash >> 15;
+    HealthCacheEntry *e = c->entries + (hash & c->mask);
+    if (e->health == bits && e->type == type && e->scale == scale && e->rounding == rounding)
+    {
+        ++c->hits;
+        *health = e->newHealth;
+        return e->result;
+    }
+
+    ++c->misses;
+    TakeHealthResult result = sim_applyOp(health, type, scale, rounding);
+    *e = (HealthCacheEntry){
+        .health = bits,
+        .rounding = rounding,
+        .type = type,
+        .result = result,
+        .scale = scale,
+        .newHealth = *health,
+    };
+    return result;
+}
+
+static int ctz32(unsigned int x)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return (int)index;
+#else
+    return __builtin_ctz(x);
+#endif
+}
+
+static int popcount32(unsigned int x)
+{
+#if defined(_MSC_VER)
+    return (int)__popcnt(x);
+#else
+    return __builtin_popcount(x);
+#endif
+}
+
+static int grid_cellX(float x)
+{
+    float c = floorf(x / TOWER_SIZE);
+    return c < 0 ? 0 : (c >= GRID_COLS ? GRID_COLS - 1 : (int)c);
+}
+
+static int grid_cellY(float y)
+{
+    float c = floorf(y / TOWER_SIZE);
+    return c < 0 ? 0 : (c >= GRID_ROWS ? GRID_ROWS - 1 : (int)c);
+}
+
+// counting sort of all live enemies into their cells, keeps ascending index order per cell
+static void grid_build(EnemyGrid *g, const EnemyList *enemies, unsigned int enemiesLen)
+{
+    unsigned int words = (enemiesLen + 31) / 32;
+    memcpy(g->live, enemies->alive, words * sizeof(g->live[0]));
+
+    memset(g->cellStart, 0, (GRID_CELLS + 1) * sizeof(g->cellStart[0]));
+    for (unsigned int w = 0; w < words; ++w)
+    {
+        for (unsigned int bits = g->live[w]; bits != 0; bits &= bits - 1)
+        {
+            unsigned int i = w * 32 + ctz32(bits);
+            int cell = grid_cellY(enemies->y[i]) * GRID_COLS + grid_cellX(enemies->x[i]);
+            ++g->cellStart[cell + 1];
+        }
+    }
+    for (int c = 0; c < GRID_CELLS; ++c)
+        g->cellStart[c + 1] += g->cellStart[c];
+    g->itemsLen = g->cellStart[GRID_CELLS];
+
+    // cellStart[c] is used as insert cursor and afterwards shifted back by one cell
+    for (unsigned int w = 0; w < words; ++w)
+    {
+        for (unsigned int bits = g->live[w]; bits != 0; bits &= bits - 1)
+        {
+            unsigned int i = w * 32 + ctz32(bits);
+            int cell = grid_cellY(enemies->y[i]) * GRID_COLS + grid_cellX(enemies->x[i]);
+            g->items[g->cellStart[cell]++] = i;
+        }
+    }
+    for (int c = GRID_CELLS; c > 0; --c)
+        g->cellStart[c] = g->cellStart[c - 1];
+    g->cellStart[0] = 0;
+}
+
+// marks all enemies in cells overlapping the given circle in the candidates bitset,
+// returns the range of touched bitset words in first/last (empty if first > last)
+static void grid_query(EnemyGrid *g, Vector2 center, float radius, unsigned int *first, unsigned int *last)
+{
+    int x0 = grid_cellX(center.x - radius);
+    int x1 = grid_cellX(center.x + radius);
+    int y0 = grid_cellY(center.y - radius);
+    int y1 = grid_cellY(center.y + radius);
+
+    *first = UINT_MAX;
+    *last = 0;
+    for (int y = y0; y <= y1; ++y)
+    {
+        for (int x = x0; x <= x1; ++x)
+        {
+            int cell = y * GRID_COLS + x;
+            for (unsigned int i = g->cellStart[cell]; i < g->cellStart[cell + 1]; ++i)
+            {
+                unsigned int index = g->items[i];
+                g->candidates[index / 32] |= 1u << (index % 32);
+                if (index / 32 < *first)
+                    *first = index / 32;
+                if (index / 32 > *last)
+                    *last = index / 32;
+            }
+        }
+    }
+}
+
+// frame in which the cooldown of the tower ends, compared with rollover
+static bool schedule_before(const Tower *towers, unsigned int a, unsigned int b)
+{
+    unsigned int readyA = towers[a].lastShot + towers[a].cooldown;
+    unsigned int readyB = towers[b].lastShot + towers[b].cooldown;
+    return (int)(readyA - readyB) < 0;
+}
+
+static void schedule_wait(TowerSchedule *s, const Tower *towers, unsigned int tower)
+{
+    unsigned int i = s->waitingLen++;
+    while (i > 0 && schedule_before(towers, tower, s->waiting[(i - 1) / 2]))
+    {
+        s->waiting[i] = s->waiting[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    s->waiting[i] = tower;
+}
+
+static unsigned int schedule_popWaiting(TowerSchedule *s, const Tower *towers)
+{
+    unsigned int top = s->waiting[0];
+    unsigned int last = s->waiting[--s->waitingLen];
+    unsigned int i = 0;
+    while (2 * i + 1 < s->waitingLen)
+    {
+        unsigned int child = 2 * i + 1;
+        if (child + 1 < s->waitingLen && schedule_before(towers, s->waiting[child + 1], s->waiting[child]))
+            ++child;
+        if (!schedule_before(towers, s->waiting[child], last))
+            break;
+        s->waiting[i] = s->waiting[child];
+        i = child;
+    }
+    s->waiting[i] = last;
+    return top;
+}
+
+// moves towers whose cooldown ended to the ready list
+static void schedule_update(TowerSchedule *s, const Tower *towers, unsigned int frame)
+{
+    while (s->waitingLen > 0)
+    {
+        const Tower *t = towers + s->waiting[0];
+        if (frame - t->lastShot < t->cooldown)
+            break;
+
+        unsigned int tower = schedule_popWaiting(s, towers);
+        unsigned int i = s->readyLen++;
+        for (; i > 0 && s->ready[i - 1] > tower; --i)
+            s->ready[i] = s->ready[i - 1];
+        s->ready[i] = tower;
+    }
+}
+
+static void fireShot(GameState *state, unsigned int frame, int i_tower, int i_enemy)
+{
+    Tower *t = state->towers + i_tower;
+    EnemyList *e = &state->enemies;
+
+    state->shots[state->shotHead % MAX_SIMUL_SHOTS] = (Shot){
+        .tower = i_tower,
+        .target = e->handle[i_enemy],
+        .targetPos = { e->x[i_enemy], e->y[i_enemy] },
+        .type = t->type,
+        .scale = t->scale,
+        .shotLife = SHOT_LIFETIME,
+    };
+    ++state->shotHead;
+    t->lastShot = frame;
+    t->shotIndex++;
+    e->towersHit[i_enemy] |= 1u << i_tower;
+
+    int res;
+    if (state->healthCache)
+        res = cache_applyOp(state->healthCache, e->health + i_enemy, t->type, t->scale, state->home.roundingFactor);
+    else
+        res = takeHealth(e->health + i_enemy, t, state->home.roundingFactor);
+
+    StateHash *h = &state->hash;
+    unsigned int slot = handle_slot(e->handle[i_enemy]);
+    hash_mix(h, HF_TOWERS, i_tower);
+    hash_mix(h, HF_TOWERS, t->lastShot);
+    hash_mix(h, HF_TOWERS, t->shotIndex);
+    hash_mix(h, HF_ENEMY_POS, slot);
+    hash_mixFloat(h, HF_ENEMY_POS, e->x[i_enemy]);
+    hash_mixFloat(h, HF_ENEMY_POS, e->y[i_enemy]);
+    hash_mix(h, HF_ENEMY_HEALTH, slot);
+    hash_mixFloat(h, HF_ENEMY_HEALTH, e->health[i_enemy]);
+
+    switch (res)
+    {
+        case TH_DEAD:
+            e->alive[i_enemy / 32] &= ~(1u << (i_enemy % 32));
+            hash_mix(h, HF_ENEMY_ALIVE, slot);
+            break;
+        case TH_SAVED_BY_ROUNDING:
+            state->msg[state->msgIndex++ % SAVED_MSGS_MAX] = (SavedMessage){
+                .pos = { e->x[i_enemy] + SAVED_MSG_OFFSET_X, e->y[i_enemy] + SAVED_MSG_OFFSET_Y },
+                .frames = SAVED_MSG_LIFETIME,
+            };
+        #ifdef _DEBUG
+            printf("Saved by rounding\n");
+        #endif
+            break;
+    }
+}
+
+static void shots_advance(GameState *state)
+{
+    for (int i_shot = state->shotTail; i_shot != state->shotHead; ++i_shot)
+    {
+        Shot *s = state->shots + (i_shot % MAX_SIMUL_SHOTS);
+
+        if (s->shotLife == 0)
+        {
+            ++state->shotTail;
+            continue;
+        }
+
+        --s->shotLife;
+    }
+}
+
+// advance save msg by the given number of frames (finished messages are left as they are)
+static void msgs_advance(GameState *state, unsigned int frames)
+{
+    for (int i = 0; i < SAVED_MSGS_MAX; ++i)
+    {
+        SavedMessage *m = state->msg + i;
+        for (unsigned int f = 0; f < frames && m->frames > 0; ++f)
+        {
+            m->frames -= 1;
+            m->pos.y += SAVED_MOVEY_PER_FRAME;
+        }
+    }
+}
+
+// enemies of block w in mask reached home this frame
+static void hash_reachedHome(GameState *state, unsigned int w, unsigned int mask)
+{
+    EnemyList *e = &state->enemies;
+    StateHash *h = &state->hash;
+    hash_mix(h, HF_HOME, state->home.health - popcount32(mask));
+    while (mask != 0)
+    {
+        unsigned int i = w * 32 + ctz32(mask);
+        mask &= mask - 1;
+        unsigned int slot = handle_slot(e->handle[i]);
+        hash_mix(h, HF_ENEMY_POS, slot);
+        hash_mixFloat(h, HF_ENEMY_POS, e->x[i]);
+        hash_mixFloat(h, HF_ENEMY_POS, e->y[i]);
+        hash_mix(h, HF_ENEMY_ALIVE, slot);
+    }
+}
+
+void level_logic(GameState *state, unsigned int frame)
+{
+    EnemyGrid *grid = &state->grid;
+    EnemyList *enemies = &state->enemies;
+    // only enemies alive at the start of the frame take part, enemies killed during
+    // targeting still get the home check and move this frame
+    grid_build(grid, enemies, state->enemiesLen);
+
+    // tower in range -> shoot
+    // Ready towers are handled one after another, each looking at the enemies of nearby
+    // cells in ascending index order. This gives the same result as checking every
+    // tower per enemy, since a tower only changes its own state and the one of the
+    // enemy it shot.
+    if (grid->itemsLen > 0)
+    {
+        TowerSchedule *schedule = &state->schedule;
+        schedule_update(schedule, state->towers, frame);
+
+        unsigned int readyLen = 0;
+        for (unsigned int i_ready = 0; i_ready < schedule->readyLen; ++i_ready)
+        {
+            int i_tower = schedule->ready[i_ready];
+            Tower *t = state->towers + i_tower;
+            if (frame - t->lastShot < t->cooldown)
+            {
+                // not ready after all (frame rollover or newly placed tower)
+                schedule_wait(schedule, state->towers, i_tower);
+                continue;
+            }
+
+            unsigned int first, last;
+            grid_query(grid, t->center, t->range + ENEMY_SIZE, &first, &last);
+            for (unsigned int w = first; w <= last && w != UINT_MAX; ++w)
+            {
+                unsigned int bits = grid->candidates[w];
+                grid->candidates[w] = 0;
+                if (bits == 0)
+                    continue;
+                // positions do not change during targeting, so the range test is
+                // done for the whole block at once
+                bits &= simd_rangeMask32(enemies->x + w * 32, enemies->y + w * 32,
+                    t->center.x, t->center.y, (float)ENEMY_SIZE + (float)t->range);
+                while (bits != 0)
+                {
+                    int i_enemy = w * 32 + ctz32(bits);
+                    bits &= bits - 1;
+
+                    if (frame - t->lastShot < t->cooldown)
+                        continue;
+                    if (!canTarget(t->type, enemies->health[i_enemy]))
+                        continue;
+                    if (enemies->towersHit[i_enemy] & (1u << i_tower))
+                        continue;
+
+                    fireShot(state, frame, i_tower, i_enemy);
+                }
+            }
+
+            if (frame - t->lastShot < t->cooldown)
+                schedule_wait(schedule, state->towers, i_tower);
+            else
+                schedule->ready[readyLen++] = i_tower;
+        }
+        schedule->readyLen = readyLen;
+    }
+
+    // touch home -> remove itself + health, otherwise move
+    bool anyDead = false;
+    for (unsigned int w = 0; w < (state->enemiesLen + 31) / 32; ++w)
+    {
+        unsigned int live = grid->live[w];
+        if (live == 0)
+            continue;
+
+        unsigned int home = live & simd_rectMask32(enemies->x + w * 32, enemies->y + w * 32, state->home.rect);
+        if (home != 0)
+            hash_reachedHome(state, w, home);
+        state->home.health -= popcount32(home);
+        enemies->alive[w] &= ~home;
+        anyDead |= (enemies->alive[w] != live);
+        simd_move32(enemies->x + w * 32, enemies->y + w * 32,
+            enemies->speedX + w * 32, enemies->speedY + w * 32, live & ~home);
+    }
+    if (anyDead)
+        enemies_compact(enemies, &state->enemiesLen);
+    shots_advance(state);
+    // spawn new enemies
+    for (int i_queue = state->queueTail; i_queue != state->queueHead; ++i_queue)
+    {
+        EnemyQueue e = state->queue[i_queue % QUEUE_SIZE];
+        // check if frame is in the future (with rollover)
+        if (e.spawnFrame - frame < frame - e.spawnFrame)
+            break;
+
+        if (state->enemiesLen >= MAX_ENEMIES)
+            break; // all slots in use, spawn as soon as one is free again
+        unsigned int i_enemy = state->enemiesLen++;
+        enemies->x[i_enemy] = ENEMY_SPAWN_X;
+        enemies->y[i_enemy] = ENEMY_SPAWN_Y;
+        enemies->speedX[i_enemy] = -0.5f;
+        enemies->speedY[i_enemy] = 0;
+        enemies->health[i_enemy] = e.health;
+        enemies->towersHit[i_enemy] = 0;
+        enemies->alive[i_enemy / 32] |= 1u << (i_enemy % 32);
+        enemies->handle[i_enemy] = enemies_allocHandle(enemies, i_enemy);
+        ++state->queueTail;
+        hash_mix(&state->hash, HF_ENEMY_ALIVE, handle_slot(enemies->handle[i_enemy]));
+        hash_mix(&state->hash, HF_QUEUE, state->queueTail);
+    }
+    msgs_advance(state, 1);
+}
+
+// Returns true if moving from p by v for up to frames steps gives the same values
+// as p + n * v, i.e. all positions in between are exactly representable floats.
+static bool isExactStep(float p, float v, unsigned int frames)
+{
+    if (v == 0)
+        return true;
+
+    // exponent of the lowest set mantissa bit of a float
+    int lowBit[2];
+    float values[2] = { p, v };
+    for (int i = 0; i < 2; ++i)
+    {
+        int exp;
+        float m = frexpf(values[i], &exp);
+        unsigned int mantissa = (unsigned int)fabsf(ldexpf(m, 24));
+        lowBit[i] = (mantissa == 0) ? INT_MAX : exp - 24 + ctz32(mantissa);
+    }
+    int quantum = lowBit[0] < lowBit[1] ? lowBit[0] : lowBit[1];
+    double end = (double)p + (double)frames * v;
+    double extent = fabs(end) > fabs(p) ? fabs(end) : fabs(p);
+    return extent < ldexp(1.0, 24 + quantum);
+}
+
+// Frames until a point moving from p by v per frame is in [lo, hi] on one axis,
+// in interval [*t0, *t1]. Returns false if it never is (for t >= 0).
+static bool slabInterval(double p, double v, double lo, double hi, double *t0, double *t1)
+{
+    if (v == 0)
+    {
+        *t0 = 0;
+        *t1 = INFINITY;
+        return p >= lo && p <= hi;
+    }
+    double a = (lo - p) / v;
+    double b = (hi - p) / v;
+    *t0 = a < b ? a : b;
+    *t1 = a < b ? b : a;
+    return *t1 >= 0;
+}
+
+// first frame t >= 0 at which the point moving from p by v is within radius of c
+static double circleEntry(double px, double py, double vx, double vy, double cx, double cy, double radius, double *exit)
+{
+    double dx = px - cx;
+    double dy = py - cy;
+    double a = vx * vx + vy * vy;
+    double b = 2 * (dx * vx + dy * vy);
+    double c = dx * dx + dy * dy - radius * radius;
+    if (a == 0)
+    {
+        *exit = INFINITY;
+        return c <= 0 ? 0 : INFINITY;
+    }
+    double disc = b * b - 4 * a * c;
+    if (disc < 0)
+        return INFINITY;
+    double t0 = (-b - sqrt(disc)) / (2 * a);
+    double t1 = (-b + sqrt(disc)) / (2 * a);
+    *exit = t1;
+    if (t1 < 0)
+        return INFINITY;
+    return t0 < 0 ? 0 : t0;
+}
+
+// turns an event time estimate into a number of frames that are certainly before it
+static unsigned int framesBefore(double t, unsigned int limit)
+{
+    t = floor(t) - 1; // margin for the float math of level_logic
+    if (t <= 0)
+        return 0;
+    return t < limit ? (unsigned int)t : limit;
+}
+
+// Number of frames starting at frame in which level_logic would not fire a shot,
+// spawn an enemy or let one reach home, at most limit. May be smaller than the
+// real number, never larger.
+static unsigned int level_quietFrames(GameState *state, unsigned int frame, unsigned int limit)
+{
+    EnemyList *enemies = &state->enemies;
+    unsigned int quiet = limit;
+
+    if (state->queueTail != state->queueHead && state->enemiesLen < MAX_ENEMIES)
+    {
+        unsigned int untilSpawn = state->queue[state->queueTail % QUEUE_SIZE].spawnFrame - frame;
+        if (untilSpawn == 0 || untilSpawn >= 1u << 31) // due or overdue
+            return 0;
+        quiet = MIN(quiet, untilSpawn);
+    }
+
+    const double epsilon = 0.01; // widen the shapes a bit against float rounding in level_logic
+    Rectangle home = state->home.rect;
+    for (unsigned int i = 0; i < state->enemiesLen && quiet > 0; ++i)
+    {
+        double px = enemies->x[i], py = enemies->y[i];
+        double vx = enemies->speedX[i], vy = enemies->speedY[i];
+
+        double tx0, tx1, ty0, ty1;
+        if (slabInterval(px, vx, home.x - epsilon, home.x + home.width + epsilon, &tx0, &tx1) &&
+            slabInterval(py, vy, home.y - epsilon, home.y + home.height + epsilon, &ty0, &ty1))
+        {
+            double t0 = tx0 > ty0 ? tx0 : ty0;
+            double t1 = tx1 < ty1 ? tx1 : ty1;
+            if (t0 <= t1 && t1 >= 0)
+                quiet = MIN(quiet, framesBefore(t0, quiet));
+        }
+
+        for (unsigned int i_tower = 0; i_tower < state->towerLen && quiet > 0; ++i_tower)
+        {
+            Tower *t = state->towers + i_tower;
+            if (enemies->towersHit[i] & (1u << i_tower))
+                continue;
+            if (!canTarget(t->type, enemies->health[i]))
+                continue; // health does not change without a shot
+
+            double exit;
+            double entry = circleEntry(px, py, vx, vy, t->center.x, t->center.y,
+                (double)ENEMY_SIZE + t->range + epsilon, &exit);
+            if (entry == INFINITY)
+                continue;
+
+            // first frame in range at which the tower is ready
+            unsigned int from = framesBefore(entry, quiet);
+            unsigned int elapsed = frame + from - t->lastShot;
+            if (elapsed < t->cooldown)
+            {
+                from += t->cooldown - elapsed;
+                if (from > exit + 1)
+                    continue; // ready only after the enemy left the range
+            }
+            quiet = MIN(quiet, from);
+        }
+    }
+
+    for (unsigned int i = 0; i < state->enemiesLen && quiet > 0; ++i)
+    {
+        if (!isExactStep(enemies->x[i], enemies->speedX[i], quiet) ||
+            !isExactStep(enemies->y[i], enemies->speedY[i], quiet))
+            return 0;
+    }
+    return quiet;
+}
+
+unsigned int level_advance(GameState *state, unsigned int frame, unsigned int maxFrames)
+{
+    assert(maxFrames > 0);
+    // bounded so tower readiness (frame - lastShot) can wrap at most once
+    unsigned int quiet = level_quietFrames(state, frame, MIN(maxFrames, 1u << 30));
+    if (quiet == 0)
+    {
+        level_logic(state, frame);
+        return 1;
+    }
+
+    EnemyList *enemies = &state->enemies;
+    for (unsigned int i = 0; i < state->enemiesLen; ++i)
+    {
+        enemies->x[i] = (float)(enemies->x[i] + (double)quiet * enemies->speedX[i]);
+        enemies->y[i] = (float)(enemies->y[i] + (double)quiet * enemies->speedY[i]);
+    }
+    for (unsigned int f = 0; f < quiet && state->shotTail != state->shotHead; ++f)
+        shots_advance(state);
+    msgs_advance(state, quiet);
+
+    return quiet;
+}
@@ -0,0 +1,410 @@
+#ifndef SIM_H
+#define SIM_H
+
+// Game simulation, independent of raylib (no window, GPU or input needed).
+// Include raylib.h before this header when both are used, the shared math
+// types below are then taken from raylib.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#if !defined(RL_VECTOR2_TYPE)
+// Vector2 type (same layout as raylib)
+typedef struct Vector2 {
+    float x;
+    float y;
+} Vector2;
+#define RL_VECTOR2_TYPE
+#endif
+
+#if !defined(RL_RECTANGLE_TYPE)
+// Rectangle type (same layout as raylib)
+typedef struct Rectangle {
+    float x;
+    float y;
+    float width;
+    float height;
+} Rectangle;
+#define RL_RECTANGLE_TYPE
+#endif
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+// play field size, matches the (unscaled) screen of the game
+#define FIELD_WIDTH 800
+#define FIELD_HEIGHT 450
+
+typedef enum EquationType
+{
+    ET_NONE = 0,
+    ET_ADD,
+    ET_SUB,
+    ET_MULT,
+    ET_DIV,
+    ET_SQR,
+    ET_SQRT,
+    ET_LOG_E,
+    ET_LOG_2,
+    ET_LOG_10,
+    ET_ROUND,
+    ET_SIN,
+    ET_COS,
+    ET_TAN,
+
+    ET_EOL
+} EquationType;
+
+#define HEALTH_DEFAULT 10
+// TODO: Split this more sensibly into "LevelParams" struct or something
+typedef struct Home // also level parameters
+{
+    Rectangle rect;
+    int health;
+    unsigned int allowedTowers; // bit mask of EquationType entries
+    int minTowers;
+    int roundingFactor;
+    int score;
+    int levelIndex;
+} Home;
+
+#define ENEMY_SIZE 20
+#define ENEMY_SPAWN_X (FIELD_WIDTH + 50)
+#define ENEMY_SPAWN_Y (FIELD_HEIGHT / 2)
+// Handle to an enemy that stays valid while the enemy is in the list. The index of
+// an enemy changes when dead enemies are compacted away at the end of a frame.
+typedef unsigned int EnemyHandle;
+#define ENEMY_HANDLE_NONE 0
+#define ENEMY_HANDLE_SLOT_BITS 16 // lower bits: slot, upper bits: generation
+
+// Enemies are stored as structure of arrays, index i of every array belongs to the
+// same enemy. Every array has room for MAX_ENEMIES entries. The list is kept in
+// spawn order and only contains live enemies after level_logic returns.
+typedef struct EnemyList
+{
+    float *x; // center
+    float *y;
+    float *speedX;
+    float *speedY;
+    float *health;
+    unsigned int *alive; // bitmask, enemy i is bit i % 32 of word i / 32
+    unsigned int *towersHit; // bitmask of tower indices that already shot the enemy
+    EnemyHandle *handle;
+
+    // handle slots
+    unsigned int *slotIndex; // enemy index of the slot
+    unsigned int *slotGeneration;
+    unsigned int *freeSlots; // stack of unused slots
+    unsigned int freeSlotsLen;
+} EnemyList;
+
+#define QUEUE_SPACING_DEFAULT 120
+typedef struct EnemyQueue
+{
+    unsigned int spawnFrame;
+    float health;
+} EnemyQueue;
+
+#define SHOT_SIZE 4
+#define SHOT_LIFETIME 12
+typedef struct Shot
+{
+    int tower;
+    EnemyHandle target;
+    Vector2 targetPos; // position when the shot was fired, used when the target is gone
+    EquationType type;
+    int scale;
+    int shotLife;
+} Shot;
+
+#define TOWER_SIZE 50
+#define TOWER_RANGE 150
+// The path runs along row PATH_TILE_Y from the spawn to home, which is the tile at
+// HOME_TILE_X. The first and the last row are under the GUI of the game.
+#define PATH_TILE_Y 4
+#define HOME_TILE_X 1
+typedef struct Tower
+{
+    Rectangle rect;
+    Vector2 center;
+    EquationType type;
+    int scale;
+    int range;
+    unsigned int lastShot; // in frames
+    unsigned int cooldown; // in frames
+    unsigned int shotIndex; // number of shots fired
+} Tower;
+
+#define SAVED_MSG_LIFETIME 60
+#define SAVED_MOVEY_PER_FRAME -0.2
+#define SAVED_MSG_OFFSET_X -30
+#define SAVED_MSG_OFFSET_Y (-ENEMY_SIZE - 4)
+typedef struct SavedMessage
+{
+    Vector2 pos;
+    int frames;
+} SavedMessage;
+
+// Uniform grid over the play field with TOWER_SIZE cells, bucketing live enemies
+// for tower range queries. Positions outside the field are clamped to the border
+// cells. Rebuilt every frame by level_logic.
+#define GRID_COLS (FIELD_WIDTH / TOWER_SIZE + 2) // +spawn area right of the screen
+#define GRID_ROWS (FIELD_HEIGHT / TOWER_SIZE + 1)
+#define GRID_CELLS (GRID_COLS * GRID_ROWS)
+typedef struct EnemyGrid
+{
+    unsigned int *cellStart; // GRID_CELLS + 1 entries, items of cell c are [cellStart[c], cellStart[c+1])
+    unsigned int *items; // enemy indices, ascending per cell
+    unsigned int itemsLen;
+    unsigned int *candidates; // bitset over enemy indices, scratch for range queries
+    unsigned int *live; // copy of the alive bitmask from the start of the frame
+} EnemyGrid;
+
+// Towers ordered by when they can shoot again. Towers on cooldown wait in a min-heap
+// keyed by the frame their cooldown ends (lastShot + cooldown), the others are in the
+// ready list in index order. Readiness is still decided by frame - lastShot >= cooldown,
+// the heap only saves looking at towers that are certainly not ready.
+typedef struct TowerSchedule
+{
+    unsigned int *waiting; // heap of tower indices
+    unsigned int waitingLen;
+    unsigned int *ready; // tower indices, ascending
+    unsigned int readyLen;
+} TowerSchedule;
+
+// Memo table for takeHealth. With rounding on, healths snap to a small set of values
+// and the same (type, scale, health) come up again and again. Entries are keyed by
+// the exact bits of the health, so results are identical to sim_applyOp. Direct
+// mapped, a colliding entry replaces the old one. Not thread safe, use one per thread.
+#define HEALTH_CACHE_BITS_DEFAULT 16
+typedef struct HealthCacheEntry
+{
+    unsigned int health; // bits of the float
+    int rounding;
+    unsigned char type; // ET_NONE: empty
+    unsigned char result; // TakeHealthResult
+    unsigned short scale;
+    float newHealth;
+} HealthCacheEntry;
+
+typedef struct HealthCache
+{
+    HealthCacheEntry *entries;
+    unsigned int mask;
+    unsigned int hits;
+    unsigned int misses;
+} HealthCache;
+
+// Hash of how the simulation played out, to find where two runs of the same input
+// part ways (two builds, or a replay and the game it was recorded in). Each field is a
+// chain, mixed by level_logic and the state_ functions where they change the state: a
+// tower shooting, an enemy losing health, dying, reaching home or spawning, and every
+// command. Frames in which enemies only move leave it as it is, so it costs nothing per
+// enemy and frame and level_advance skips over the same frames. Positions go in where
+// they decide something (a shot, reaching home). Enemies are identified by handle slot.
+// state_reset clears it: two states have the same hash if they played out the same
+// since the last (re)start.
+// The hash is event based: it does not give the first frame at which two runs differ.
+// A movement that goes another way shows up at the next shot or arrival at home, which
+// can be many frames later. desync (src/desync.c) traces the positions of all enemies
+// after every frame for that.
+typedef enum HashField
+{
+    HF_ENEMY_POS,
+    HF_ENEMY_HEALTH,
+    HF_ENEMY_ALIVE,
+    HF_TOWERS, // placed, lastShot and shotIndex
+    HF_QUEUE, // entries and cursors
+    HF_HOME, // health and level parameters
+
+    HF_EOL
+} HashField;
+
+typedef struct StateHash
+{
+    unsigned int field[HF_EOL];
+} StateHash;
+
+typedef struct GameState
+{
+    Home home;
+
+    Tower *towers;
+    unsigned int towerLen;
+    TowerSchedule schedule;
+
+    EnemyList enemies;
+    unsigned int enemiesLen;
+
+    EnemyQueue *queue; // needs to be ordered by spawnFrame (lowest first)
+    unsigned int queueHead;
+    unsigned int queueTail;
+
+    Shot *shots;
+    unsigned int shotHead;
+    unsigned int shotTail;
+
+    SavedMessage *msg;
+    unsigned int msgIndex;
+
+    EnemyGrid grid;
+
+    HealthCache *healthCache; // optional, not owned and not copied by state_copy
+    StateHash hash;
+
+    // all arrays above live in this one allocation, the state ones first and the grid
+    // (scratch) after them
+    unsigned char *block;
+    size_t blockCopyBytes;
+} GameState;
+
+#define MAX_TOWERS 32 // at most 32, see EnemyList.towersHit
+#define MAX_ENEMIES 1024 // multiple of 32 (see EnemyList.alive)
+#define QUEUE_SIZE 64
+#define SAVED_MSGS_MAX 32
+#define MAX_SIMUL_SHOTS MAX_TOWERS
+
+typedef enum LevelCat
+{
+    LC_NATURAL,
+    LC_INTEGER,
+    LC_RATIONAL,
+    LC_REAL,
+
+    LC_EOL
+} LevelCat;
+
+typedef struct LevelDef
+{
+    const char *name;
+    LevelCat cat;
+    const char *health;
+    int count;
+    int spacing;
+    unsigned int towersAllowed;
+    int minSolution;
+    int roundingFactor;
+} LevelDef;
+
+typedef enum TakeHealthResult
+{
+    TH_DEAD,
+    TH_ALIVE,
+    TH_SAVED_BY_ROUNDING,
+} TakeHealthResult;
+
+// Input to the simulation. Everything the player changes goes through a command so
+// it can be handed to a simulation running on another thread.
+typedef enum SimCommandType
+{
+    CMD_NONE = 0,
+    CMD_ADD_TOWER,
+    CMD_ADD_QUEUE, // spawns start at the frame the command is applied
+    CMD_RESET,
+    CMD_LOAD_LEVEL, // reset and load level, restarts at frame 0
+    CMD_SET_ROUNDING,
+
+    CMD_EOL
+} SimCommandType;
+
+#define SIM_COMMAND_TEXT_SIZE 256
+typedef struct SimCommand
+{
+    SimCommandType type;
+    int tileX; // CMD_ADD_TOWER
+    int tileY;
+    EquationType tower;
+    int scale;
+    char health[SIM_COMMAND_TEXT_SIZE]; // CMD_ADD_QUEUE
+    unsigned int count;
+    unsigned int spacing;
+    LevelDef level; // CMD_LOAD_LEVEL
+    int levelIndex;
+    int roundingFactor; // CMD_SET_ROUNDING
+} SimCommand;
+
+static inline bool enemy_isAlive(const EnemyList *e, unsigned int i)
+{
+    return (e->alive[i / 32] >> (i % 32)) & 1;
+}
+
+// returns the current index of the enemy or -1 if it was removed
+static inline int enemy_find(const EnemyList *e, EnemyHandle h)
+{
+    unsigned int slot = h & ((1u << ENEMY_HANDLE_SLOT_BITS) - 1);
+    if (slot >= MAX_ENEMIES || e->slotGeneration[slot] != h >> ENEMY_HANDLE_SLOT_BITS)
+        return -1;
+    return e->slotIndex[slot];
+}
+
+void state_init(GameState *s);
+void state_free(GameState *s);
+void state_reset(GameState *s);
+void state_addTower(GameState *s, int tileX, int tileY, int type, int scale);
+// returns true if all entries were added
+bool state_addQueueFromString(GameState *s, unsigned int startFrame, const char *queue, unsigned int count, unsigned int spacing);
+void state_loadFromLevelDef(GameState *state, LevelDef l, int index);
+// Copies the complete simulation state, dst has to be initialized with state_init.
+// Every GameState is one block (see GameState.block), so a spare one is a snapshot:
+// taking and restoring it is a single copy of blockCopyBytes (about 48 KB) that
+// never allocates.
+void state_copy(GameState *dst, const GameState *src);
+// applies cmd at the given frame, returns false if it was rejected (e.g. tile is taken)
+bool sim_applyCommand(GameState *state, unsigned int *frame, const SimCommand *cmd);
+// true once all enemies are gone or home is dead
+bool state_isOver(const GameState *state);
+// stars once all enemies are gone: 1 if home took damage, 2 above par, 3 at par,
+// 4 below par. 0 while enemies are left.
+int state_score(const GameState *state);
+// all fields of state->hash in one number
+unsigned int state_hash(const GameState *state);
+// the step of every chain of StateHash: h with value mixed in
+unsigned int sim_hashMix(unsigned int h, unsigned int value);
+
+// lower case names, e.g. "sqrt" or "log_10"
+extern const char *EQUATION_NAMES[ET_EOL];
+// lower case names of the StateHash fields, e.g. "enemy_pos"
+extern const char *HASH_FIELD_NAMES[HF_EOL];
+
+bool canTarget(EquationType tower, float health);
+// scale of towers placed in levels (the playground lets the player choose)
+int defaultTowerScale(EquationType type);
+// True if the player can put a tower on the tile: inside the field, not on the path or
+// home and not under the GUI. Towers already placed are not checked.
+bool sim_canPlaceTile(int tileX, int tileY);
+// takes health and returns state of enemy
+TakeHealthResult takeHealth(float *health, const Tower *t, int rounding);
+// same as takeHealth, for a tower of the given type and scale
+TakeHealthResult sim_applyOp(float *health, EquationType type, int scale, int rounding);
+// Exact health arithmetic for a roundingFactor of up to HEALTH_FIXED_MAX_ROUNDING:
+// healths are whole numbers of grid steps (1 / rounding), +, -, *, / and x² are done
+// on those with 64 bit integers and rounded half away from zero. Returns false (health
+// untouched) if the op is not one of those, health is not on the grid or a value
+// reaches HEALTH_FIXED_LIMIT steps. Not used by the simulation, which keeps the float
+// math of sim_applyOp for every level; it is no faster (bench takeHealth_fixed_r*).
+// Checked against sim_applyOp for every grid value below the limit with scales 1 to
+// 10: at rounding 1 the results are the same bit for bit. Above 2^23 steps they are
+// not, the float math rounds / twice (e.g. 9437206 / 9). At rounding 10 they differ
+// for ties of / 6 (0.9 / 6 = 0.15 gives 0.2, not 0.1), squares of 258.2 and above,
+// and a result of one step after + or - 2 and more (or / 9), which the float math
+// counts as saved by rounding.
+#define HEALTH_FIXED_MAX_ROUNDING 10
+#define HEALTH_FIXED_LIMIT (1 << 22) // grid steps
+bool sim_applyOpFixed(float *health, EquationType type, int scale, int rounding, TakeHealthResult *result);
+
+void cache_init(HealthCache *c, int bits);
+void cache_free(HealthCache *c);
+// same as sim_applyOp, looked up in the cache first
+TakeHealthResult cache_applyOp(HealthCache *c, float *health, EquationType type, int scale, int rounding);
+
+// number of allocations done by the simulation so far (all threads)
+int sim_allocationCount(void);
+
+// advance the simulation by one frame
+void level_logic(GameState *state, unsigned int frame);
+// Advance the simulation by up to maxFrames frames, jumping over frames in which
+// nothing but movement happens. Returns the number of frames advanced (at least 1),
+// the state is the same as after calling level_logic for each of those frames.
+unsigned int level_advance(GameState *state, unsigned int frame, unsigned int maxFrames);
+
+#endif // SIM_H
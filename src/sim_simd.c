@@ -0,0 +1,294 @@
+#include <float.h>
+
+#include "sim_simd.h"
+
+#if defined(SIM_SIMD_AVX)
+    #include <immintrin.h>
+#elif defined(SIM_SIMD_SSE)
+    #include <emmintrin.h>
+#elif defined(SIM_SIMD_NEON)
+    #include <arm_neon.h>
+#endif
+
+#if defined(SIM_SIMD_NEON)
+static unsigned int neon_movemask(uint32x4_t m)
+{
+    static const uint32_t bits[4] = { 1, 2, 4, 8 };
+    return vaddvq_u32(vandq_u32(m, vld1q_u32(bits)));
+}
+#endif
+
+unsigned int simd_rangeMask32(const float *x, const float *y, float cx, float cy, float radius)
+{
+    float radiusSquared = radius * radius;
+    unsigned int mask = 0;
+#if defined(SIM_SIMD_AVX)
+    __m256 vcx = _mm256_set1_ps(cx);
+    __m256 vcy = _mm256_set1_ps(cy);
+    __m256 vr2 = _mm256_set1_ps(radiusSquared);
+    for (int i = 0; i < 32; i += 8)
+    {
+        __m256 dx = _mm256_sub_ps(vcx, _mm256_loadu_ps(x + i));
+        __m256 dy = _mm256_sub_ps(vcy, _mm256_loadu_ps(y + i));
+        __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        mask |= (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(d2, vr2, _CMP_LE_OQ)) << i;
+    }
+#elif defined(SIM_SIMD_SSE)
+    __m128 vcx = _mm_set1_ps(cx);
+    __m128 vcy = _mm_set1_ps(cy);
+    __m128 vr2 = _mm_set1_ps(radiusSquared);
+    for (int i = 0; i < 32; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(vcx, _mm_loadu_ps(x + i));
+        __m128 dy = _mm_sub_ps(vcy, _mm_loadu_ps(y + i));
+        __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        mask |= (unsigned int)_mm_movemask_ps(_mm_cmple_ps(d2, vr2)) << i;
+    }
+#elif defined(SIM_SIMD_NEON)
+    float32x4_t vcx = vdupq_n_f32(cx);
+    float32x4_t vcy = vdupq_n_f32(cy);
+    float32x4_t vr2 = vdupq_n_f32(radiusSquared);
+    for (int i = 0; i < 32; i += 4)
+    {
+        float32x4_t dx = vsubq_f32(vcx, vld1q_f32(x + i));
+        float32x4_t dy = vsubq_f32(vcy, vld1q_f32(y + i));
+        float32x4_t d2 = vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy));
+        mask |= neon_movemask(vcleq_f32(d2, vr2)) << i;
+    }
+#else
+    for (int i = 0; i < 32; ++i)
+    {
+        float dx = cx - x[i];
+        float dy = cy - y[i];
+        float d2 = dx * dx;
+        d2 += dy * dy;
+        if (d2 <= radiusSquared)
+            mask |= 1u << i;
+    }
+#endif
+    return mask;
+}
+
+unsigned int simd_rectMask32(const float *x, const float *y, Rectangle rect)
+{
+    float right = rect.x + rect.width;
+    float bottom = rect.y + rect.height;
+    unsigned int mask = 0;
+#if defined(SIM_SIMD_AVX)
+    __m256 left8 = _mm256_set1_ps(rect.x), right8 = _mm256_set1_ps(right);
+    __m256 top8 = _mm256_set1_ps(rect.y), bottom8 = _mm256_set1_ps(bottom);
+    for (int i = 0; i < 32; i += 8)
+    {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 in = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(px, left8, _CMP_GE_OQ), _mm256_cmp_ps(px, right8, _CMP_LT_OQ)),
+            _mm256_and_ps(_mm256_cmp_ps(py, top8, _CMP_GE_OQ), _mm256_cmp_ps(py, bottom8, _CMP_LT_OQ)));
+        mask |= (unsigned int)_mm256_movemask_ps(in) << i;
+    }
+#elif defined(SIM_SIMD_SSE)
+    __m128 left4 = _mm_set1_ps(rect.x), right4 = _mm_set1_ps(right);
+    __m128 top4 = _mm_set1_ps(rect.y), bottom4 = _mm_set1_ps(bottom);
+    for (int i = 0; i < 32; i += 4)
+    {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 in = _mm_and_ps(
+            _mm_and_ps(_mm_cmpge_ps(px, left4), _mm_cmplt_ps(px, right4)),
+            _mm_and_ps(_mm_cmpge_ps(py, top4), _mm_cmplt_ps(py, bottom4)));
+        mask |= (unsigned int)_mm_movemask_ps(in) << i;
+    }
+#elif defined(SIM_SIMD_NEON)
+    float32x4_t left4 = vdupq_n_f32(rect.x), right4 = vdupq_n_f32(right);
+    float32x4_t top4 = vdupq_n_f32(rect.y), bottom4 = vdupq_n_f32(bottom);
+    for (int i = 0; i < 32; i += 4)
+    {
+        float32x4_t px = vld1q_f32(x + i);
+        float32x4_t py = vld1q_f32(y + i);
+        uint32x4_t in = vandq_u32(
+            vandq_u32(vcgeq_f32(px, left4), vcltq_f32(px, right4)),
+            vandq_u32(vcgeq_f32(py, top4), vcltq_f32(py, bottom4)));
+        mask |= neon_movemask(in) << i;
+    }
+#else
+    for (int i = 0; i < 32; ++i)
+    {
+        if (x[i] >= rect.x && x[i] < right && y[i] >= rect.y && y[i] < bottom)
+            mask |= 1u << i;
+    }
+#endif
+    return mask;
+}
+
+void simd_move32(float *x, float *y, const float *speedX, const float *speedY, unsigned int mask)
+{
+    if (mask == 0)
+        return;
+    // 4 lanes are enough here, AVX builds use the SSE version
+#if defined(SIM_SIMD_SSE)
+    const __m128i laneBits = _mm_set_epi32(8, 4, 2, 1);
+    for (int i = 0; i < 32; i += 4)
+    {
+        unsigned int laneMask = (mask >> i) & 0xF;
+        if (laneMask == 0)
+            continue;
+        __m128 m = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(laneMask), laneBits), laneBits));
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 nx = _mm_add_ps(px, _mm_loadu_ps(speedX + i));
+        __m128 ny = _mm_add_ps(py, _mm_loadu_ps(speedY + i));
+        _mm_storeu_ps(x + i, _mm_or_ps(_mm_and_ps(m, nx), _mm_andnot_ps(m, px)));
+        _mm_storeu_ps(y + i, _mm_or_ps(_mm_and_ps(m, ny), _mm_andnot_ps(m, py)));
+    }
+#elif defined(SIM_SIMD_NEON)
+    static const uint32_t bits[4] = { 1, 2, 4, 8 };
+    const uint32x4_t laneBits = vld1q_u32(bits);
+    for (int i = 0; i < 32; i += 4)
+    {
+        unsigned int laneMask = (mask >> i) & 0xF;
+        if (laneMask == 0)
+            continue;
+        uint32x4_t m = vceqq_u32(vandq_u32(vdupq_n_u32(laneMask), laneBits), laneBits);
+        float32x4_t px = vld1q_f32(x + i);
+        float32x4_t py = vld1q_f32(y + i);
+        vst1q_f32(x + i, vbslq_f32(m, vaddq_f32(px, vld1q_f32(speedX + i)), px));
+        vst1q_f32(y + i, vbslq_f32(m, vaddq_f32(py, vld1q_f32(speedY + i)), py));
+    }
+#else
+    for (int i = 0; i < 32; ++i)
+    {
+        if ((mask >> i) & 1)
+        {
+            x[i] += speedX[i];
+            y[i] += speedY[i];
+        }
+    }
+#endif
+}
+
+static void applyOpScalar(float *health, unsigned char *result, EquationType type, int scale, int rounding)
+{
+    if (canTarget(type, *health))
+        *result = sim_applyOp(health, type, scale, rounding);
+    else
+        *result = TH_ALIVE;
+}
+
+void simd_applyOp(float *health, unsigned char *result, int len, EquationType type, int scale, int rounding)
+{
+    int i = 0;
+    // 4 lanes, AVX builds use the SSE version
+#if defined(SIM_SIMD_SSE)
+    if (type >= ET_ADD && type <= ET_SQRT)
+    {
+        const __m128 signBit = _mm_set1_ps(-0.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 epsilon = _mm_set1_ps(FLT_EPSILON);
+        const __m128 scale4 = _mm_set1_ps((float)scale);
+        const __m128 rounding4 = _mm_set1_ps((float)rounding);
+        for (; i + 4 <= len; i += 4)
+        {
+            __m128 h = _mm_loadu_ps(health + i);
+            __m128 x;
+            __m128 targeted = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            switch (type)
+            {
+                case ET_ADD: x = _mm_add_ps(h, scale4); break;
+                case ET_SUB: x = _mm_sub_ps(h, scale4); break;
+                case ET_MULT: x = _mm_mul_ps(h, scale4); break;
+                case ET_DIV: x = _mm_div_ps(h, scale4); break;
+                case ET_SQR: x = _mm_mul_ps(h, h); break;
+                default:
+                    x = _mm_sqrt_ps(h);
+                    targeted = _mm_cmpgt_ps(h, _mm_setzero_ps());
+                    break;
+            }
+
+            __m128 saved = _mm_setzero_ps();
+            if (rounding > 0)
+            {
+                __m128 scaled = _mm_mul_ps(x, rounding4);
+                // (float)(int)scaled / rounding
+                __m128 notRounded = _mm_div_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(scaled)), rounding4);
+                saved = _mm_cmplt_ps(_mm_andnot_ps(signBit, notRounded), epsilon);
+
+                // roundf: half away from zero, values from 2^23 up (and nan, inf) are whole already
+                __m128 magnitude = _mm_andnot_ps(signBit, scaled);
+                __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(magnitude));
+                __m128 fraction = _mm_sub_ps(magnitude, truncated);
+                __m128 rounded = _mm_add_ps(truncated, _mm_and_ps(_mm_cmpge_ps(fraction, half), one));
+                rounded = _mm_or_ps(rounded, _mm_and_ps(signBit, scaled));
+                __m128 small = _mm_cmplt_ps(magnitude, _mm_set1_ps(8388608.0f));
+                rounded = _mm_or_ps(_mm_and_ps(small, rounded), _mm_andnot_ps(small, scaled));
+                x = _mm_div_ps(rounded, rounding4);
+            }
+            __m128 dead = _mm_cmplt_ps(_mm_andnot_ps(signBit, x), epsilon);
+
+            _mm_storeu_ps(health + i, _mm_or_ps(_mm_and_ps(targeted, x), _mm_andnot_ps(targeted, h)));
+            unsigned int deadMask = _mm_movemask_ps(_mm_and_ps(targeted, dead));
+            unsigned int savedMask = _mm_movemask_ps(_mm_and_ps(targeted, saved));
+            for (int k = 0; k < 4; ++k)
+            {
+                if (deadMask & (1u << k))
+                    result[i + k] = TH_DEAD;
+                else if (savedMask & (1u << k))
+                    result[i + k] = TH_SAVED_BY_ROUNDING;
+                else
+                    result[i + k] = TH_ALIVE;
+            }
+        }
+    }
+#elif defined(SIM_SIMD_NEON)
+    if (type >= ET_ADD && type <= ET_SQRT)
+    {
+        const float32x4_t epsilon = vdupq_n_f32(FLT_EPSILON);
+        const float32x4_t scale4 = vdupq_n_f32((float)scale);
+        const float32x4_t rounding4 = vdupq_n_f32((float)rounding);
+        for (; i + 4 <= len; i += 4)
+        {
+            float32x4_t h = vld1q_f32(health + i);
+            float32x4_t x;
+            uint32x4_t targeted = vdupq_n_u32(0xFFFFFFFFu);
+            switch (type)
+            {
+                case ET_ADD: x = vaddq_f32(h, scale4); break;
+                case ET_SUB: x = vsubq_f32(h, scale4); break;
+                case ET_MULT: x = vmulq_f32(h, scale4); break;
+                case ET_DIV: x = vdivq_f32(h, scale4); break;
+                case ET_SQR: x = vmulq_f32(h, h); break;
+                default:
+                    x = vsqrtq_f32(h);
+                    targeted = vcgtq_f32(h, vdupq_n_f32(0));
+                    break;
+            }
+
+            uint32x4_t saved = vdupq_n_u32(0);
+            if (rounding > 0)
+            {
+                float32x4_t scaled = vmulq_f32(x, rounding4);
+                float32x4_t notRounded = vdivq_f32(vcvtq_f32_s32(vcvtq_s32_f32(scaled)), rounding4);
+                saved = vcltq_f32(vabsq_f32(notRounded), epsilon);
+                x = vdivq_f32(vrndaq_f32(scaled), rounding4); // roundf
+            }
+            uint32x4_t dead = vcltq_f32(vabsq_f32(x), epsilon);
+
+            vst1q_f32(health + i, vbslq_f32(targeted, x, h));
+            unsigned int deadMask = neon_movemask(vandq_u32(targeted, dead));
+            unsigned int savedMask = neon_movemask(vandq_u32(targeted, saved));
+            for (int k = 0; k < 4; ++k)
+            {
+                if (deadMask & (1u << k))
+                    result[i + k] = TH_DEAD;
+                else if (savedMask & (1u << k))
+                    result[i + k] = TH_SAVED_BY_ROUNDING;
+                else
+                    result[i + k] = TH_ALIVE;
+            }
+        }
+    }
+#endif
+    for (; i < len; ++i)
+        applyOpScalar(health + i, result + i, type, scale, rounding);
+}
+
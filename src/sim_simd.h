@@ -0,0 +1,32 @@
+#ifndef SIM_SIMD_H
+#define SIM_SIMD_H
+
+// Vector kernels for the simulation, working on blocks of 32 enemies (one word of
+// the alive bitmask) from the structure of arrays in EnemyList, or on plain arrays
+// of healths (simd_applyOp, used by the solver). Uses AVX, SSE2 or NEON depending
+// on the target, with a plain C fallback. All kernels produce the same results as
+// the scalar code in sim.c (no fused multiply-add).
+
+#include "sim.h"
+
+#if defined(__AVX__)
+    #define SIM_SIMD_AVX
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define SIM_SIMD_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #define SIM_SIMD_NEON
+#endif
+
+// bit i set if enemy i is within radius of (cx, cy), same test as checkCollisionCircles
+unsigned int simd_rangeMask32(const float *x, const float *y, float cx, float cy, float radius);
+// bit i set if enemy i is inside rect, same test as checkCollisionPointRec
+unsigned int simd_rectMask32(const float *x, const float *y, Rectangle rect);
+// adds speed to the position of all enemies with their bit set in mask
+void simd_move32(float *x, float *y, const float *speedX, const float *speedY, unsigned int mask);
+// Applies a tower to len healths like sim_applyOp, same results bit for bit. Healths
+// the tower cannot target (canTarget) are left alone and get TH_ALIVE. Vectorized
+// for +, -, *, /, x² and sqrt, the other ops go through sim_applyOp one by one.
+void simd_applyOp(float *health, unsigned char *result, int len, EquationType type, int scale, int rounding);
+
+#endif // SIM_SIMD_H
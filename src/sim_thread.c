@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "sim_thread.h"
+
+#define SNAPSHOT_INDEX 3
+#define SNAPSHOT_FRESH 4
+
+void simthread_init(SimThread *s)
+{
+    *s = (SimThread){ .speed = 1 };
+    state_init(&s->state);
+    cache_init(&s->cache, HEALTH_CACHE_BITS_DEFAULT);
+    s->state.healthCache = &s->cache;
+    for (int i = 0; i < 3; ++i)
+        state_init(&s->snapshots[i].state);
+    s->commands = calloc(SIM_COMMANDS_MAX, sizeof(s->commands[0]));
+}
+
+void simthread_free(SimThread *s)
+{
+    if (s->running)
+        simthread_stop(s, NULL, NULL);
+    state_free(&s->state);
+    cache_free(&s->cache);
+    for (int i = 0; i < 3; ++i)
+        state_free(&s->snapshots[i].state);
+    free(s->commands);
+}
+
+static void simthread_publish(SimThread *s)
+{
+    SimSnapshot *snap = &s->snapshots[s->back];
+    state_copy(&snap->state, &s->state);
+    snap->frame = s->frame;
+    snap->commandsApplied = s->commandTail;
+    s->back = atomic_swap(&s->shared, s->back | SNAPSHOT_FRESH) & SNAPSHOT_INDEX;
+}
+
+static void simthread_run(void *arg)
+{
+    SimThread *s = arg;
+    const double tick = 1.0 / SIM_TICK_RATE;
+    double nextTick = thread_time();
+
+    while (atomic_get(&s->running))
+    {
+        nextTick += tick;
+
+        // input
+        int tail = s->commandTail;
+        int head = atomic_get(&s->commandHead);
+        for (; tail != head; ++tail)
+        {
+            const SimCommand *cmd = s->commands + (tail & (SIM_COMMANDS_MAX - 1));
+            unsigned int frame = s->frame;
+            bool accepted = sim_applyCommand(&s->state, &s->frame, cmd);
+            if (s->replay)
+                replay_recordCommand(s->replay, frame, cmd, accepted);
+        }
+        atomic_set(&s->commandTail, tail);
+
+        // logic
+        bool stopWhenOver = atomic_get(&s->stopWhenOver);
+        bool paused = atomic_get(&s->paused);
+        int speed = atomic_get(&s->speed);
+        if (s->replay)
+            replay_recordSpeed(s->replay, s->frame, paused ? REPLAY_PAUSED : speed);
+        if (!paused && !(stopWhenOver && state_isOver(&s->state)))
+        {
+            unsigned int total = 0;
+            if (speed == SPEED_TURBO)
+            {
+                // use up the whole tick
+                do
+                {
+                    unsigned int frames = level_advance(&s->state, s->frame, TURBO_MAX_SKIP);
+                    s->frame += frames;
+                    total += frames;
+                } while (thread_time() < nextTick && !(stopWhenOver && state_isOver(&s->state)));
+            }
+            else
+            {
+                while (total < (unsigned int)speed)
+                {
+                    // skips ahead over frames where nothing but movement happens
+                    unsigned int frames = level_advance(&s->state, s->frame, speed - total);
+                    s->frame += frames;
+                    total += frames;
+                }
+            }
+            atomic_add(&s->framesSimulated, total);
+        }
+
+        simthread_publish(s);
+
+        double now = thread_time();
+        if (now > nextTick + 0.25)
+            nextTick = now; // fell behind, do not try to catch up
+        while (now < nextTick && atomic_get(&s->running))
+        {
+            thread_sleepMs(1);
+            now = thread_time();
+        }
+    }
+}
+
+bool simthread_start(SimThread *s, const GameState *state, unsigned int frame)
+{
+    state_copy(&s->state, state);
+    s->frame = frame;
+    for (int i = 0; i < 3; ++i)
+    {
+        state_copy(&s->snapshots[i].state, state);
+        s->snapshots[i].frame = frame;
+        s->snapshots[i].commandsApplied = 0;
+    }
+    s->back = 0;
+    s->shared = 1;
+    s->front = 2;
+    s->commandHead = s->commandTail = 0;
+
+    atomic_set(&s->running, 1);
+    if (!thread_start(&s->thread, simthread_run, s))
+    {
+        printf("WARNING: Could not start simulation thread\n");
+        atomic_set(&s->running, 0);
+        return false;
+    }
+    return true;
+}
+
+void simthread_stop(SimThread *s, GameState *state, unsigned int *frame)
+{
+    atomic_set(&s->running, 0);
+    thread_join(&s->thread);
+
+    if (state)
+        state_copy(state, &s->state);
+    if (frame)
+        *frame = s->frame;
+}
+
+bool simthread_send(SimThread *s, const SimCommand *cmd)
+{
+    int head = s->commandHead;
+    if (head - atomic_get(&s->commandTail) >= SIM_COMMANDS_MAX)
+        return false;
+
+    s->commands[head & (SIM_COMMANDS_MAX - 1)] = *cmd;
+    atomic_set(&s->commandHead, head + 1);
+    return true;
+}
+
+const SimSnapshot *simthread_acquire(SimThread *s)
+{
+    if (atomic_get(&s->shared) & SNAPSHOT_FRESH)
+        s->front = atomic_swap(&s->shared, s->front) & SNAPSHOT_INDEX;
+    return &s->snapshots[s->front];
+}
@@ -0,0 +1,68 @@
+#ifndef SIM_THREAD_H
+#define SIM_THREAD_H
+
+// Runs the simulation on a worker thread at a fixed tick of SIM_TICK_RATE.
+// The renderer never touches the simulated state: after every tick the worker
+// publishes a copy into a lock-free triple buffer and the renderer picks up the
+// newest one. Player input goes the other way through a single producer, single
+// consumer command ring.
+
+#include "sim.h"
+#include "thread.h"
+#include "replay.h"
+
+#define SIM_TICK_RATE 60
+#define SIM_COMMANDS_MAX 64 // power of two
+#define SPEED_TURBO -1 // speed: as many frames as fit into one tick
+#define TURBO_MAX_SKIP 3600 // frames per level_advance call, keeps the frame counter sane when idle
+
+typedef struct SimSnapshot
+{
+    GameState state;
+    unsigned int frame;
+    int commandsApplied; // number of commands sent before this snapshot was taken
+} SimSnapshot;
+
+typedef struct SimThread
+{
+    Thread thread;
+    volatile int running;
+
+    // owned by the worker
+    GameState state;
+    unsigned int frame;
+    HealthCache cache;
+
+    // triple buffer: worker writes snapshots[back], renderer reads snapshots[front],
+    // shared holds the third index plus SNAPSHOT_FRESH if it was not picked up yet
+    SimSnapshot snapshots[3];
+    int back;
+    int front;
+    volatile int shared;
+
+    SimCommand *commands; // ring, written by the renderer, read by the worker
+    volatile int commandHead;
+    volatile int commandTail;
+
+    // playback settings, written by the renderer
+    volatile int speed; // frames per tick or SPEED_TURBO
+    volatile int paused;
+    volatile int stopWhenOver; // stop advancing once all enemies are gone or home is dead
+    volatile int framesSimulated; // total, for measuring the turbo rate
+
+    // optional, set before simthread_start, the worker records into it while running
+    Replay *replay;
+} SimThread;
+
+void simthread_init(SimThread *s);
+void simthread_free(SimThread *s);
+// copies state and frame to the worker and starts it, returns false if threads are unavailable
+bool simthread_start(SimThread *s, const GameState *state, unsigned int frame);
+// stops the worker and copies its state back
+void simthread_stop(SimThread *s, GameState *state, unsigned int *frame);
+// returns false if the ring is full, the command is dropped then
+bool simthread_send(SimThread *s, const SimCommand *cmd);
+// newest published snapshot, stays valid until the next call
+const SimSnapshot *simthread_acquire(SimThread *s);
+
+#endif // SIM_THREAD_H
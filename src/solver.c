@@ -0,0 +1,798 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "solver.h"
+#include "graph.h"
+#include "sim_simd.h"
+#include "thread.h"
+
+// Iterative deepening search over operation sequences. The search state is the set
+// of healths still alive (sorted, without duplicates), so enemies with the same
+// health are only simulated once. A transposition table remembers how many
+// operations were left when a set was searched before; visiting it again with the
+// same or fewer operations left cannot find anything new. The health graph of the
+// level (graph.h) gives a lower bound for every set: the most ops any of its healths
+// needs on its own. Sets that need more than the operations left are cut right away.
+// Building the graph only pays off for long searches, it is built before an iteration
+// once the iterations before took GRAPH_AFTER_NODES nodes.
+//
+// The parallel search splits every iteration into tasks: the children of nodes above
+// SPLIT_DEPTH are pushed to the deque of the worker instead of being searched right
+// away. Workers take tasks from the bottom of their own deque (newest, smallest) and
+// steal from the top of the others (oldest, biggest). The first solution of the
+// current depth is the bound for everyone, all workers stop once it is known. The
+// workers share one transposition table without a lock (see TTEntry) and their
+// threads live through all iterations. A worker with nothing to steal sleeps on the
+// wake signal of the pool, which moves on with every pushed task, at the end of an
+// iteration and at the start of the next.
+//
+// The hint search is the same iterative deepening, with the recursion turned into an
+// explicit stack so it can stop after any node and continue on the next call. Its
+// state also includes how many fixed towers were passed: a node either applies the
+// next fixed tower (free) or inserts a tower (counts against the depth). It cuts with
+// the health graph too, every fixed tower left is one op of the bound for free. The
+// graph is built once the search runs long and kept while the level keeps its ops:
+// restarts come with every placed tower and only leave out healths that already
+// spawned, which the graph still has.
+
+#define TT_BITS 20
+#define TT_SIZE (1u << TT_BITS)
+
+#define SPLIT_DEPTH 3
+#define SPLIT_MIN_REMAINING 4 // smaller subtrees are not worth a task
+#define DEQUE_SIZE 256
+#define DEQUE_SPINS 64 // pauses before a thread waiting for a deque lock yields the core
+
+#define GRAPH_AFTER_NODES 20000
+
+#define HINT_TT_BITS 16 // smaller than TT_BITS, the table is cleared on every restart
+#define HINT_TT_SIZE (1u << HINT_TT_BITS)
+#define HINT_MAX_FRAMES (HINT_MAX_FIXED + SOLVER_MAX_DEPTH + 1)
+#define HINT_GRAPH_MAX_NODES (1 << 12) // built within one slice, a full size one takes ~30 ms
+
+// The parallel search shares the table between threads without a lock. Each word is
+// read and written whole (atomic_get64), but an entry is two words written one after
+// the other. check is key ^ data, so a reader that gets the words of two different
+// writes sees a check that does not match its key and takes the entry as empty.
+typedef struct TTEntry
+{
+    volatile unsigned long long check; // key ^ data, 0 = empty entry
+    volatile unsigned long long data; // operations left when the set was searched
+} TTEntry;
+
+typedef struct SearchTask
+{
+    float set[SOLVER_MAX_HEALTHS];
+    int len;
+    int depth;
+    int remaining;
+    SolverOp path[SOLVER_MAX_DEPTH];
+} SearchTask;
+
+typedef struct TaskDeque
+{
+    SearchTask *tasks;
+    int top; // next to steal
+    int bottom; // next free
+    volatile int lock;
+} TaskDeque;
+
+typedef struct HintFrame
+{
+    float set[SOLVER_MAX_HEALTHS];
+    int len;
+    int fixedIndex; // fixed towers passed
+    int left; // towers left to insert
+    int next; // child to try next: -1 the fixed tower, then the index of the op to insert
+    int taken; // child the frame above came from
+} HintFrame;
+
+typedef struct SearchPool SearchPool;
+
+typedef struct Search
+{
+    const SolverLevel *level;
+    const HealthGraph *graph; // optional
+    TTEntry *table;
+    float sets[SOLVER_MAX_DEPTH + 1][SOLVER_MAX_HEALTHS];
+    SolverOp path[SOLVER_MAX_DEPTH];
+    int solutionLen;
+    HealthCache cache;
+    unsigned long long nodes; // searched so far
+
+    // parallel search only
+    SearchPool *pool;
+    TaskDeque deque;
+    unsigned int random;
+    Thread thread;
+} Search;
+
+struct SearchPool
+{
+    Search *workers;
+    int workerLen;
+    volatile int pending; // tasks pushed but not finished yet
+    volatile int found; // set by the first worker finding a solution
+    volatile int iteration; // the threads join in when it changes
+    volatile int stop;
+    ThreadSignal wake; // see above
+    Solution solution;
+};
+
+static int compareFloat(const void *a, const void *b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+// sorts and removes duplicates, returns the new length
+static int set_normalize(float *set, int len)
+{
+    qsort(set, len, sizeof(float), compareFloat);
+    int out = 0;
+    for (int i = 0; i < len; ++i)
+    {
+        if (out == 0 || set[out - 1] != set[i])
+            set[out++] = set[i];
+    }
+    return out;
+}
+
+static unsigned long long set_hash(const float *set, int len)
+{
+    unsigned long long h = 1469598103934665603ull ^ (unsigned int)len;
+    for (int i = 0; i < len; ++i)
+    {
+        unsigned int bits;
+        memcpy(&bits, set + i, sizeof(bits));
+        h = (h ^ bits) * 1099511628211ull;
+        h ^= h >> 29;
+    }
+    return h != 0 ? h : 1;
+}
+
+// Applies op to every health in the set. Returns the length of the new (normalized)
+// set, or -1 if that leaves a health that can never die (inf, nan).
+static int set_applyAlways(const SolverLevel *l, HealthCache *cache, SolverOp op, const float *in, int len, float *out)
+{
+    int outLen = 0;
+    if (op.type >= ET_ADD && op.type <= ET_SQRT)
+    {
+        unsigned char result[SOLVER_MAX_HEALTHS];
+        memcpy(out, in, len * sizeof(float));
+        simd_applyOp(out, result, len, op.type, op.scale, l->roundingFactor);
+        for (int i = 0; i < len; ++i)
+        {
+            if (result[i] == TH_DEAD)
+                continue;
+            if (!isfinite(out[i]))
+                return -1;
+            out[outLen++] = out[i];
+        }
+        return set_normalize(out, outLen);
+    }
+
+    for (int i = 0; i < len; ++i)
+    {
+        float h = in[i];
+        if (!canTarget(op.type, h))
+        {
+            out[outLen++] = h;
+            continue;
+        }
+        TakeHealthResult res = cache_applyOp(cache, &h, op.type, op.scale, l->roundingFactor);
+        if (res == TH_DEAD)
+            continue;
+        if (!isfinite(h))
+            return -1;
+        out[outLen++] = h;
+    }
+    return set_normalize(out, outLen);
+}
+
+// Same as set_applyAlways, also -1 if the op is useless (changes nothing).
+static int set_apply(const SolverLevel *l, HealthCache *cache, SolverOp op, const float *in, int len, float *out)
+{
+    int outLen = set_applyAlways(l, cache, op, in, len, out);
+    if (outLen < 0 || (outLen == len && memcmp(in, out, len * sizeof(float)) == 0))
+        return -1;
+    return outLen;
+}
+
+static void deque_lock(TaskDeque *d)
+{
+    // held for the copy of one task, on a busy machine the holder may need the core
+    for (int spin = 0; !atomic_cas(&d->lock, 0, 1); ++spin)
+    {
+        if (spin < DEQUE_SPINS)
+            thread_pause();
+        else
+            thread_yield();
+    }
+}
+
+static void deque_unlock(TaskDeque *d)
+{
+    atomic_set(&d->lock, 0);
+}
+
+// returns false if the deque is full
+static bool deque_push(TaskDeque *d, const SearchTask *task)
+{
+    deque_lock(d);
+    if (d->bottom == DEQUE_SIZE && d->top > 0)
+    {
+        // move the remaining tasks to the front
+        memmove(d->tasks, d->tasks + d->top, (d->bottom - d->top) * sizeof(SearchTask));
+        d->bottom -= d->top;
+        d->top = 0;
+    }
+    bool full = (d->bottom == DEQUE_SIZE);
+    if (!full)
+        d->tasks[d->bottom++] = *task;
+    deque_unlock(d);
+    return !full;
+}
+
+// takes from the bottom (owner) or the top (thief)
+static bool deque_pop(TaskDeque *d, SearchTask *task, bool steal)
+{
+    deque_lock(d);
+    bool empty = (d->top == d->bottom);
+    if (!empty)
+        *task = steal ? d->tasks[d->top++] : d->tasks[--d->bottom];
+    if (d->top == d->bottom)
+        d->top = d->bottom = 0;
+    deque_unlock(d);
+    return !empty;
+}
+
+// most ops any health of the set needs on its own, GRAPH_UNREACHABLE if one can never die
+static int set_lowerBound(const HealthGraph *g, const float *set, int len)
+{
+    int bound = 0;
+    for (int i = 0; i < len; ++i)
+    {
+        int distance = graph_distance(g, set[i]);
+        if (distance > bound)
+            bound = distance;
+    }
+    return bound;
+}
+
+// True if the set of key was already searched with at least remaining operations
+// left. Records it otherwise, replacing always: the newest entries are the most
+// likely to be hit again.
+static bool tt_visit(TTEntry *table, unsigned int mask, unsigned long long key, int remaining)
+{
+    TTEntry *e = table + (key & mask);
+    unsigned long long data = atomic_get64(&e->data);
+    if ((atomic_get64(&e->check) ^ data) == key && (int)data >= remaining)
+        return true;
+    atomic_set64(&e->check, key ^ (unsigned long long)remaining);
+    atomic_set64(&e->data, remaining);
+    return false;
+}
+
+static bool search_dfs(Search *s, int depth, int len, int remaining)
+{
+    if (s->pool && atomic_get(&s->pool->found))
+        return false;
+
+    ++s->nodes;
+    const float *set = s->sets[depth];
+    if (s->graph && set_lowerBound(s->graph, set, len) > remaining)
+        return false;
+    if (tt_visit(s->table, TT_SIZE - 1, set_hash(set, len), remaining))
+        return false;
+
+    bool split = s->pool && depth < SPLIT_DEPTH && remaining >= SPLIT_MIN_REMAINING;
+    for (int i = 0; i < s->level->opsLen; ++i)
+    {
+        SolverOp op = s->level->ops[i];
+        int childLen = set_apply(s->level, &s->cache, op, set, len, s->sets[depth + 1]);
+        if (childLen < 0)
+            continue;
+
+        s->path[depth] = op;
+        if (childLen == 0)
+        {
+            s->solutionLen = depth + 1;
+            return true;
+        }
+        if (remaining <= 1)
+            continue;
+
+        if (split)
+        {
+            SearchTask task = { .len = childLen, .depth = depth + 1, .remaining = remaining - 1 };
+            memcpy(task.set, s->sets[depth + 1], childLen * sizeof(float));
+            memcpy(task.path, s->path, (depth + 1) * sizeof(SolverOp));
+            atomic_add(&s->pool->pending, 1);
+            if (deque_push(&s->deque, &task))
+            {
+                signal_notify(&s->pool->wake);
+                continue;
+            }
+            atomic_add(&s->pool->pending, -1); // full, search it right here
+        }
+        if (search_dfs(s, depth + 1, childLen, remaining - 1))
+            return true;
+    }
+    return false;
+}
+
+static void search_runTask(Search *s, const SearchTask *task)
+{
+    memcpy(s->sets[task->depth], task->set, task->len * sizeof(float));
+    memcpy(s->path, task->path, task->depth * sizeof(SolverOp));
+    if (search_dfs(s, task->depth, task->len, task->remaining) && atomic_cas(&s->pool->found, 0, 1))
+    {
+        memcpy(s->pool->solution.ops, s->path, s->solutionLen * sizeof(SolverOp));
+        s->pool->solution.len = s->solutionLen;
+    }
+}
+
+static void search_worker(void *arg)
+{
+    Search *s = arg;
+    SearchPool *pool = s->pool;
+    SearchTask *task = malloc(sizeof(SearchTask));
+    while (atomic_get(&pool->pending) > 0)
+    {
+        int seen = signal_count(&pool->wake);
+        bool got = deque_pop(&s->deque, task, false);
+        // every other deque once, from a random one on
+        s->random = s->random * 1103515245u + 12345u;
+        int first = (s->random >> 16) % pool->workerLen;
+        for (int i = 0; !got && i < pool->workerLen; ++i)
+        {
+            Search *victim = pool->workers + (first + i) % pool->workerLen;
+            if (victim != s)
+                got = deque_pop(&victim->deque, task, true);
+        }
+        if (!got)
+        {
+            // others are still busy, their children may come up for stealing
+            if (atomic_get(&pool->pending) > 0)
+                signal_wait(&pool->wake, seen);
+            continue;
+        }
+
+        // once found the remaining tasks are only drained
+        if (!atomic_get(&pool->found))
+            search_runTask(s, task);
+        if (atomic_add(&pool->pending, -1) == 1)
+            signal_notify(&pool->wake); // the iteration is done
+    }
+    free(task);
+}
+
+// the threads besides the caller, they take part in every iteration until the pool stops
+static void search_thread(void *arg)
+{
+    Search *s = arg;
+    SearchPool *pool = s->pool;
+    int iteration = 0;
+    for (;;)
+    {
+        int seen = signal_count(&pool->wake);
+        if (atomic_get(&pool->stop))
+            break;
+        int next = atomic_get(&pool->iteration);
+        if (next == iteration)
+        {
+            signal_wait(&pool->wake, seen);
+            continue;
+        }
+        iteration = next;
+        search_worker(s);
+    }
+}
+
+static void search_init(Search *s, const SolverLevel *l, TTEntry *table)
+{
+    s->level = l;
+    s->table = table;
+    memcpy(s->sets[0], l->health, l->healthLen * sizeof(float));
+    cache_init(&s->cache, HEALTH_CACHE_BITS_DEFAULT);
+}
+
+static void search_free(Search *s)
+{
+    cache_free(&s->cache);
+}
+
+void solver_initHealths(SolverLevel *l, const float *health, int len, unsigned int towersAllowed, int roundingFactor)
+{
+    *l = (SolverLevel){ .roundingFactor = roundingFactor };
+    for (int i = 0; i < len && l->healthLen < SOLVER_MAX_HEALTHS; ++i)
+    {
+        if (health[i] == 0 || !isfinite(health[i]))
+            continue;
+        int j = 0;
+        while (j < l->healthLen && l->health[j] != health[i])
+            ++j;
+        if (j == l->healthLen)
+            l->health[l->healthLen++] = health[i];
+    }
+    l->healthLen = set_normalize(l->health, l->healthLen);
+
+    for (int type = ET_NONE + 1; type < ET_EOL; ++type)
+    {
+        if (towersAllowed & (1u << type))
+            l->ops[l->opsLen++] = (SolverOp){ type, defaultTowerScale(type) };
+    }
+}
+
+void solver_initLevel(SolverLevel *l, const LevelDef *def)
+{
+    // same parsing as state_addQueueFromString
+    float health[SOLVER_MAX_HEALTHS];
+    int len = 0;
+    const char *queue = def->health;
+    for (const char *pos = queue + strspn(queue, ",;"); *pos != 0; pos += strspn(pos, ",;"))
+    {
+        float value = atof(pos);
+        pos += strcspn(pos, ",;");
+        if (value == 0 || !isfinite(value) || len >= SOLVER_MAX_HEALTHS)
+            continue;
+        health[len++] = value;
+    }
+    solver_initHealths(l, health, len, def->towersAllowed, def->roundingFactor);
+}
+
+int solver_solve(const SolverLevel *l, int maxDepth, Solution *solution)
+{
+    if (maxDepth > SOLVER_MAX_DEPTH)
+        maxDepth = SOLVER_MAX_DEPTH;
+    if (l->healthLen == 0)
+    {
+        if (solution)
+            solution->len = 0;
+        return 0;
+    }
+
+    HealthGraph graph;
+    bool haveGraph = false;
+    TTEntry *table = calloc(TT_SIZE, sizeof(TTEntry));
+    Search *s = calloc(1, sizeof(Search));
+    search_init(s, l, table);
+
+    int result = -1;
+    for (int depth = 1; depth <= maxDepth && result < 0; ++depth)
+    {
+        if (!haveGraph && s->nodes >= GRAPH_AFTER_NODES)
+        {
+            haveGraph = graph_build(&graph, l, GRAPH_MAX_NODES_DEFAULT, GRAPH_MAX_HEALTH_DEFAULT);
+            s->graph = haveGraph ? &graph : NULL;
+        }
+        if (search_dfs(s, 0, l->healthLen, depth))
+            result = s->solutionLen;
+    }
+
+    if (solution && result >= 0)
+    {
+        memcpy(solution->ops, s->path, result * sizeof(SolverOp));
+        solution->len = result;
+    }
+
+    search_free(s);
+    free(s);
+    free(table);
+    if (haveGraph)
+        graph_free(&graph);
+    return result;
+}
+
+int solver_solveParallel(const SolverLevel *l, int maxDepth, int threadCount, Solution *solution)
+{
+    if (threadCount <= 1 || l->healthLen == 0)
+        return solver_solve(l, maxDepth, solution);
+    if (maxDepth > SOLVER_MAX_DEPTH)
+        maxDepth = SOLVER_MAX_DEPTH;
+
+    HealthGraph graph;
+    bool haveGraph = false;
+    SearchPool pool = { .workerLen = threadCount };
+    if (!signal_init(&pool.wake))
+        return solver_solve(l, maxDepth, solution);
+    TTEntry *table = calloc(TT_SIZE, sizeof(TTEntry));
+    pool.workers = calloc(threadCount, sizeof(Search));
+    for (int i = 0; i < threadCount; ++i)
+    {
+        Search *s = pool.workers + i;
+        search_init(s, l, table);
+        s->pool = &pool;
+        s->deque.tasks = malloc(DEQUE_SIZE * sizeof(SearchTask));
+        s->random = 0x9E3779B9u * (i + 1);
+    }
+    // the calling thread is worker 0
+    int started = 1;
+    for (; started < threadCount; ++started)
+    {
+        if (!thread_start(&pool.workers[started].thread, search_thread, pool.workers + started))
+            break;
+    }
+
+    int result = -1;
+    for (int depth = 1; depth <= maxDepth && result < 0; ++depth)
+    {
+        unsigned long long nodes = 0;
+        for (int i = 0; i < threadCount; ++i)
+            nodes += pool.workers[i].nodes;
+        if (!haveGraph && nodes >= GRAPH_AFTER_NODES)
+        {
+            // read only during the search, shared by all workers
+            haveGraph = graph_build(&graph, l, GRAPH_MAX_NODES_DEFAULT, GRAPH_MAX_HEALTH_DEFAULT);
+            for (int i = 0; i < threadCount; ++i)
+                pool.workers[i].graph = haveGraph ? &graph : NULL;
+        }
+        SearchTask *root = calloc(1, sizeof(SearchTask));
+        *root = (SearchTask){ .len = l->healthLen, .depth = 0, .remaining = depth };
+        memcpy(root->set, l->health, l->healthLen * sizeof(float));
+        atomic_set(&pool.found, 0);
+        atomic_set(&pool.pending, 1);
+        deque_push(&pool.workers[0].deque, root);
+        free(root);
+
+        atomic_add(&pool.iteration, 1);
+        signal_notify(&pool.wake);
+        search_worker(pool.workers);
+        // all tasks are done, threads still looking for one find nothing to take
+        if (atomic_get(&pool.found))
+            result = pool.solution.len;
+    }
+    atomic_set(&pool.stop, 1);
+    signal_notify(&pool.wake);
+    for (int i = 1; i < started; ++i)
+        thread_join(&pool.workers[i].thread);
+    signal_free(&pool.wake);
+
+    if (solution && result >= 0)
+        *solution = pool.solution;
+
+    for (int i = 0; i < threadCount; ++i)
+    {
+        search_free(pool.workers + i);
+        free(pool.workers[i].deque.tasks);
+    }
+    free(pool.workers);
+    free(table);
+    if (haveGraph)
+        graph_free(&graph);
+    return result;
+}
+
+static int describeOp(SolverOp op, char *text, int size)
+{
+    switch (op.type)
+    {
+        case ET_ADD: return snprintf(text, size, "[+%d]", op.scale);
+        case ET_SUB: return snprintf(text, size, "[-%d]", op.scale);
+        case ET_MULT: return snprintf(text, size, "[*%d]", op.scale);
+        case ET_DIV: return snprintf(text, size, "[/%d]", op.scale);
+        case ET_SQR: return snprintf(text, size, "[sqr]");
+        case ET_SQRT: return snprintf(text, size, "[sqrt]");
+        case ET_LOG_E: return snprintf(text, size, "[ln]");
+        case ET_LOG_2: return snprintf(text, size, "[log_2]");
+        case ET_LOG_10: return snprintf(text, size, "[log_10]");
+        case ET_ROUND: return snprintf(text, size, "[round %d]", op.scale - 1);
+        case ET_SIN: return snprintf(text, size, "[sin]");
+        case ET_COS: return snprintf(text, size, "[cos]");
+        case ET_TAN: return snprintf(text, size, "[tan]");
+        default: return snprintf(text, size, "[?]");
+    }
+}
+
+void solver_describe(const Solution *solution, char *text, int size)
+{
+    int len = 0;
+    char op[32] = "";
+    text[0] = 0;
+    for (int i = 0; i < solution->len; )
+    {
+        int repeat = 1;
+        while (i + repeat < solution->len
+            && solution->ops[i + repeat].type == solution->ops[i].type
+            && solution->ops[i + repeat].scale == solution->ops[i].scale)
+            ++repeat;
+
+        describeOp(solution->ops[i], op, sizeof(op));
+        if (repeat > 1)
+            len += snprintf(text + len, size - len, "%s%s * %d", i > 0 ? ", " : "", op, repeat);
+        else
+            len += snprintf(text + len, size - len, "%s%s", i > 0 ? ", " : "", op);
+        if (len >= size)
+            break; // truncated
+        i += repeat;
+    }
+}
+
+int solver_playSolution(GameState *s, const LevelDef *def, int index, const Solution *solution)
+{
+    state_reset(s);
+    state_loadFromLevelDef(s, *def, index);
+    for (int i = 0; i < solution->len; ++i)
+    {
+        // pairs above and below the path come into range in the same frame and
+        // shoot in index order
+        int tileX = (FIELD_WIDTH / TOWER_SIZE - 1) - i / 2;
+        int tileY = (i % 2 == 0) ? 3 : 5;
+        state_addTower(s, tileX, tileY, solution->ops[i].type, solution->ops[i].scale);
+    }
+
+    unsigned int frame = 0;
+    while (!state_isOver(s))
+        frame += level_advance(s, frame, -1);
+    return s->home.health;
+}
+
+// Enters the frame above the top one, its set is already filled in. Returns true if
+// that kills everything.
+static bool hint_enter(HintSearch *h, int len, int fixedIndex, int left)
+{
+    if (len == 0)
+        return true;
+    if (left == 0 && fixedIndex == h->fixedLen)
+        return false; // nothing left to apply
+
+    ++h->nodes;
+    HintFrame *f = h->frames + h->frameLen;
+    if (h->graph && h->fixedInGraph && set_lowerBound(h->graph, f->set, len) - (h->fixedLen - fixedIndex) > left)
+        return false;
+    unsigned long long key = set_hash(f->set, len) ^ ((fixedIndex + 1) * 0x9E3779B97F4A7C15ull);
+    if (tt_visit(h->table, HINT_TT_SIZE - 1, key != 0 ? key : 1, left))
+        return false;
+
+    f->len = len;
+    f->fixedIndex = fixedIndex;
+    f->left = left;
+    f->next = (fixedIndex < h->fixedLen) ? -1 : 0;
+    ++h->frameLen;
+    return false;
+}
+
+static void hint_found(HintSearch *h)
+{
+    h->status = HINT_FOUND;
+    h->towersLeft = h->inserts;
+    h->position = -1;
+    for (int i = 0; i < h->frameLen; ++i)
+    {
+        if (h->frames[i].taken >= 0)
+        {
+            h->op = h->level.ops[h->frames[i].taken];
+            h->position = h->frames[i].fixedIndex;
+            break;
+        }
+    }
+}
+
+static void hint_dropGraph(HintSearch *h)
+{
+    if (h->graph)
+        graph_free(h->graph);
+    free(h->graph);
+    h->graph = NULL;
+    h->nodes = 0;
+}
+
+// true if the graph has the ops and rounding of l and all of its healths
+static bool hint_graphFits(const HealthGraph *g, const SolverLevel *l)
+{
+    if (g->opsLen != l->opsLen || memcmp(g->ops, l->ops, l->opsLen * sizeof(SolverOp)) != 0
+        || g->roundingFactor != l->roundingFactor)
+        return false;
+    for (int i = 0; i < l->healthLen; ++i)
+    {
+        if (graph_node(g, l->health[i]) < 0)
+            return false;
+    }
+    return true;
+}
+
+void solver_hintBegin(HintSearch *h, const SolverLevel *l, const SolverOp *fixed, int fixedLen,
+    unsigned long long insertAllowed, int maxInsert)
+{
+    // the buffers of an earlier search are reused
+    if (h->table == NULL)
+    {
+        h->table = malloc(HINT_TT_SIZE * sizeof(TTEntry));
+        h->frames = malloc(HINT_MAX_FRAMES * sizeof(HintFrame));
+        cache_init(&h->cache, HEALTH_CACHE_BITS_DEFAULT);
+    }
+    memset(h->table, 0, HINT_TT_SIZE * sizeof(TTEntry));
+    if (h->graph && !hint_graphFits(h->graph, l))
+        hint_dropGraph(h);
+
+    h->level = *l;
+    h->fixedLen = MIN(fixedLen, HINT_MAX_FIXED);
+    memcpy(h->fixed, fixed, h->fixedLen * sizeof(SolverOp));
+    // towers placed at another scale (playground) are not edges of the graph
+    h->fixedInGraph = true;
+    for (int i = 0; i < h->fixedLen; ++i)
+    {
+        int o = 0;
+        while (o < l->opsLen && (l->ops[o].type != fixed[i].type || l->ops[o].scale != fixed[i].scale))
+            ++o;
+        h->fixedInGraph &= (o < l->opsLen);
+    }
+    h->insertAllowed = insertAllowed;
+    h->maxInsert = MIN(maxInsert, SOLVER_MAX_DEPTH);
+    h->inserts = -1;
+    h->frameLen = 0;
+    h->status = HINT_RUNNING;
+    h->towersLeft = 0;
+    h->position = -1;
+}
+
+HintStatus solver_hintStep(HintSearch *h, int budget)
+{
+    const SolverLevel *l = &h->level;
+    if (h->graph == NULL && h->nodes >= GRAPH_AFTER_NODES && h->status == HINT_RUNNING)
+    {
+        h->graph = malloc(sizeof(HealthGraph));
+        if (h->graph && !graph_build(h->graph, l, HINT_GRAPH_MAX_NODES, GRAPH_MAX_HEALTH_DEFAULT))
+            hint_dropGraph(h); // tries again after as many nodes
+    }
+    for (; budget > 0 && h->status == HINT_RUNNING; --budget)
+    {
+        if (h->frameLen == 0)
+        {
+            // next iteration, the table carries over: a set that failed with n
+            // insertions left still fails with fewer
+            if (++h->inserts > h->maxInsert)
+            {
+                h->status = HINT_NONE;
+                break;
+            }
+            memcpy(h->frames[0].set, l->health, l->healthLen * sizeof(float));
+            if (hint_enter(h, l->healthLen, 0, h->inserts))
+                hint_found(h);
+            continue;
+        }
+
+        HintFrame *f = h->frames + h->frameLen - 1;
+        HintFrame *child = f + 1;
+        int choice = f->next++;
+        int len = -1;
+        int fixedIndex = f->fixedIndex;
+        int left = f->left;
+        if (choice < 0)
+        {
+            // the towers already placed fire no matter what
+            len = set_applyAlways(l, &h->cache, h->fixed[fixedIndex], f->set, f->len, child->set);
+            ++fixedIndex;
+        }
+        else if (choice < l->opsLen && left > 0 && (h->insertAllowed & (1ull << fixedIndex)))
+        {
+            len = set_apply(l, &h->cache, l->ops[choice], f->set, f->len, child->set);
+            --left;
+        }
+        else
+        {
+            --h->frameLen; // all children done
+            continue;
+        }
+
+        f->taken = choice;
+        if (len >= 0 && hint_enter(h, len, fixedIndex, left))
+            hint_found(h);
+    }
+    return h->status;
+}
+
+void solver_hintEnd(HintSearch *h)
+{
+    hint_dropGraph(h);
+    if (h->table)
+        cache_free(&h->cache);
+    free(h->table);
+    free(h->frames);
+    h->table = NULL;
+    h->frames = NULL;
+}
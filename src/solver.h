@@ -0,0 +1,95 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+// Par solver: finds the smallest number of towers that kills every enemy of a level.
+// Enemies walk the same path, so every enemy meets the towers in the same order.
+// A solution is a sequence of tower operations; each enemy takes every operation
+// once, in order, with the same takeHealth, canTarget and rounding rules as the game.
+// A tower that cannot target an enemy lets it pass, and a dead enemy takes no more
+// operations.
+
+#include "sim.h"
+
+#define SOLVER_MAX_HEALTHS 64 // distinct starting healths
+#define SOLVER_MAX_DEPTH 16
+#define HINT_MAX_FIXED MAX_TOWERS
+
+typedef struct SolverOp
+{
+    EquationType type;
+    int scale;
+} SolverOp;
+
+typedef struct SolverLevel
+{
+    float health[SOLVER_MAX_HEALTHS]; // distinct, sorted
+    int healthLen;
+    SolverOp ops[ET_EOL];
+    int opsLen;
+    int roundingFactor;
+} SolverLevel;
+
+typedef struct Solution
+{
+    SolverOp ops[SOLVER_MAX_DEPTH];
+    int len;
+} Solution;
+
+// Resumable search for the fewest towers to add to the ones already placed (fixed).
+// Fixed towers keep their order, inserting before fixed tower p is only allowed if
+// bit p of insertAllowed is set (p = fixedLen: after the last one). Iterative
+// deepening over the number of inserted towers, run in slices of solver_hintStep so
+// the caller decides how much time it gets.
+typedef enum HintStatus
+{
+    HINT_RUNNING,
+    HINT_FOUND,
+    HINT_NONE, // not with at most maxInsert towers
+} HintStatus;
+
+typedef struct HintSearch
+{
+    SolverLevel level;
+    SolverOp fixed[HINT_MAX_FIXED];
+    int fixedLen;
+    unsigned long long insertAllowed;
+    int maxInsert;
+    int inserts; // of the current iteration
+    struct HintFrame *frames; // explicit stack of the depth first search
+    int frameLen;
+    struct TTEntry *table;
+    HealthCache cache;
+    struct HealthGraph *graph; // of level, NULL until the search runs long, kept across restarts
+    bool fixedInGraph; // every fixed tower is an op of the graph, so it takes one off the bound
+    unsigned long long nodes; // entered since the graph was dropped
+
+    // result
+    HintStatus status;
+    int towersLeft; // inserted towers of the solution
+    SolverOp op; // first inserted tower
+    int position; // inserted before fixed tower position, -1: nothing to insert
+} HintSearch;
+
+// healths from the level string, allowed towers at defaultTowerScale
+void solver_initLevel(SolverLevel *l, const LevelDef *def);
+// the first SOLVER_MAX_HEALTHS distinct non-zero healths, allowed towers at defaultTowerScale
+void solver_initHealths(SolverLevel *l, const float *health, int len, unsigned int towersAllowed, int roundingFactor);
+// Returns the minimal number of towers (<= maxDepth) and the sequence in solution,
+// or -1 if there is none with at most maxDepth towers.
+int solver_solve(const SolverLevel *l, int maxDepth, Solution *solution);
+// Same result as solver_solve, searched by threadCount threads (the calling thread
+// is one of them). Which of several minimal solutions is returned may differ.
+int solver_solveParallel(const SolverLevel *l, int maxDepth, int threadCount, Solution *solution);
+// text like "[sqrt] * 4, [-1]"
+void solver_describe(const Solution *solution, char *text, int size);
+// Plays the level with the towers of the solution placed along the path, in the order
+// the enemies meet them. Returns the home health at the end.
+int solver_playSolution(GameState *s, const LevelDef *def, int index, const Solution *solution);
+
+void solver_hintBegin(HintSearch *h, const SolverLevel *l, const SolverOp *fixed, int fixedLen,
+    unsigned long long insertAllowed, int maxInsert);
+// expands at most budget nodes, returns the status (also in h->status)
+HintStatus solver_hintStep(HintSearch *h, int budget);
+void solver_hintEnd(HintSearch *h);
+
+#endif // SOLVER_H
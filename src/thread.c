@@ -0,0 +1,392 @@
+#include <stdlib.h>
+
+#include "thread.h"
+
+#if defined(_WIN32)
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+typedef struct ThreadStart
+{
+    ThreadFunc func;
+    void *arg;
+} ThreadStart;
+
+static DWORD WINAPI thread_entry(LPVOID param)
+{
+    ThreadStart start = *(ThreadStart *)param;
+    free(param);
+    start.func(start.arg);
+    return 0;
+}
+
+bool thread_start(Thread *t, ThreadFunc func, void *arg)
+{
+    ThreadStart *start = malloc(sizeof(ThreadStart));
+    *start = (ThreadStart){ func, arg };
+    t->handle = CreateThread(NULL, 0, thread_entry, start, 0, NULL);
+    if (t->handle == NULL)
+    {
+        free(start);
+        return false;
+    }
+    return true;
+}
+
+void thread_join(Thread *t)
+{
+    if (t->handle == NULL)
+        return;
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+    t->handle = NULL;
+}
+
+int thread_cpuCount(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+void thread_sleepMs(int ms)
+{
+    Sleep(ms);
+}
+
+void thread_pause(void)
+{
+    YieldProcessor();
+}
+
+void thread_yield(void)
+{
+    SwitchToThread();
+}
+
+typedef struct SignalImpl
+{
+    SRWLOCK lock;
+    CONDITION_VARIABLE cond;
+} SignalImpl;
+
+bool signal_init(ThreadSignal *s)
+{
+    SignalImpl *impl = malloc(sizeof(SignalImpl));
+    *s = (ThreadSignal){ .handle = impl };
+    if (impl == NULL)
+        return false;
+    InitializeSRWLock(&impl->lock);
+    InitializeConditionVariable(&impl->cond);
+    return true;
+}
+
+void signal_free(ThreadSignal *s)
+{
+    free(s->handle);
+    s->handle = NULL;
+}
+
+void signal_wait(ThreadSignal *s, int count)
+{
+    SignalImpl *impl = s->handle;
+    AcquireSRWLockExclusive(&impl->lock);
+    atomic_add(&s->waiters, 1);
+    while (atomic_get(&s->count) == count)
+        SleepConditionVariableSRW(&impl->cond, &impl->lock, INFINITE, 0);
+    atomic_add(&s->waiters, -1);
+    ReleaseSRWLockExclusive(&impl->lock);
+}
+
+void signal_notify(ThreadSignal *s)
+{
+    atomic_add(&s->count, 1);
+    // a waiter counts itself before it looks at the count, so it either sees the new
+    // count or is counted here
+    if (atomic_get(&s->waiters) == 0)
+        return;
+    SignalImpl *impl = s->handle;
+    AcquireSRWLockExclusive(&impl->lock);
+    WakeAllConditionVariable(&impl->cond);
+    ReleaseSRWLockExclusive(&impl->lock);
+}
+
+double thread_time(void)
+{
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart / freq.QuadPart;
+}
+
+int atomic_get(volatile int *p)
+{
+    return InterlockedCompareExchange((volatile LONG *)p, 0, 0);
+}
+
+void atomic_set(volatile int *p, int value)
+{
+    InterlockedExchange((volatile LONG *)p, value);
+}
+
+int atomic_swap(volatile int *p, int value)
+{
+    return InterlockedExchange((volatile LONG *)p, value);
+}
+
+bool atomic_cas(volatile int *p, int expected, int desired)
+{
+    return InterlockedCompareExchange((volatile LONG *)p, desired, expected) == expected;
+}
+
+int atomic_add(volatile int *p, int value)
+{
+    return InterlockedExchangeAdd((volatile LONG *)p, value);
+}
+
+unsigned long long atomic_get64(volatile unsigned long long *p)
+{
+#if defined(_WIN64)
+    return *p; // aligned 64 bit accesses are whole on x64 and ARM64
+#else
+    return InterlockedCompareExchange64((volatile LONGLONG *)p, 0, 0);
+#endif
+}
+
+void atomic_set64(volatile unsigned long long *p, unsigned long long value)
+{
+#if defined(_WIN64)
+    *p = value;
+#else
+    LONGLONG old = *p;
+    LONGLONG seen;
+    while ((seen = InterlockedCompareExchange64((volatile LONGLONG *)p, value, old)) != old)
+        old = seen;
+#endif
+}
+
+#else // gcc / clang
+
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+    #define THREAD_NONE
+#else
+    #include <pthread.h>
+#endif
+
+#if defined(THREAD_NONE)
+
+bool thread_start(Thread *t, ThreadFunc func, void *arg)
+{
+    (void)func;
+    (void)arg;
+    t->handle = NULL;
+    return false;
+}
+
+void thread_join(Thread *t)
+{
+    (void)t;
+}
+
+int thread_cpuCount(void)
+{
+    return 1;
+}
+
+bool signal_init(ThreadSignal *s)
+{
+    *s = (ThreadSignal){ 0 };
+    return true;
+}
+
+void signal_free(ThreadSignal *s)
+{
+    (void)s;
+}
+
+void signal_wait(ThreadSignal *s, int count)
+{
+    // nobody else could move the count on
+    (void)s;
+    (void)count;
+}
+
+void signal_notify(ThreadSignal *s)
+{
+    atomic_add(&s->count, 1);
+}
+
+#else
+
+typedef struct ThreadStart
+{
+    ThreadFunc func;
+    void *arg;
+} ThreadStart;
+
+static void *thread_entry(void *param)
+{
+    ThreadStart start = *(ThreadStart *)param;
+    free(param);
+    start.func(start.arg);
+    return NULL;
+}
+
+bool thread_start(Thread *t, ThreadFunc func, void *arg)
+{
+    pthread_t *handle = malloc(sizeof(pthread_t));
+    ThreadStart *start = malloc(sizeof(ThreadStart));
+    *start = (ThreadStart){ func, arg };
+    if (pthread_create(handle, NULL, thread_entry, start) != 0)
+    {
+        free(start);
+        free(handle);
+        t->handle = NULL;
+        return false;
+    }
+    t->handle = handle;
+    return true;
+}
+
+void thread_join(Thread *t)
+{
+    if (t->handle == NULL)
+        return;
+    pthread_join(*(pthread_t *)t->handle, NULL);
+    free(t->handle);
+    t->handle = NULL;
+}
+
+int thread_cpuCount(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+typedef struct SignalImpl
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} SignalImpl;
+
+bool signal_init(ThreadSignal *s)
+{
+    SignalImpl *impl = malloc(sizeof(SignalImpl));
+    *s = (ThreadSignal){ .handle = impl };
+    if (impl == NULL)
+        return false;
+    pthread_mutex_init(&impl->mutex, NULL);
+    pthread_cond_init(&impl->cond, NULL);
+    return true;
+}
+
+void signal_free(ThreadSignal *s)
+{
+    SignalImpl *impl = s->handle;
+    if (impl == NULL)
+        return;
+    pthread_mutex_destroy(&impl->mutex);
+    pthread_cond_destroy(&impl->cond);
+    free(impl);
+    s->handle = NULL;
+}
+
+void signal_wait(ThreadSignal *s, int count)
+{
+    SignalImpl *impl = s->handle;
+    pthread_mutex_lock(&impl->mutex);
+    atomic_add(&s->waiters, 1);
+    while (atomic_get(&s->count) == count)
+        pthread_cond_wait(&impl->cond, &impl->mutex);
+    atomic_add(&s->waiters, -1);
+    pthread_mutex_unlock(&impl->mutex);
+}
+
+void signal_notify(ThreadSignal *s)
+{
+    atomic_add(&s->count, 1);
+    // a waiter counts itself before it looks at the count, so it either sees the new
+    // count or is counted here
+    if (atomic_get(&s->waiters) == 0)
+        return;
+    SignalImpl *impl = s->handle;
+    pthread_mutex_lock(&impl->mutex);
+    pthread_cond_broadcast(&impl->cond);
+    pthread_mutex_unlock(&impl->mutex);
+}
+
+#endif // THREAD_NONE
+
+void thread_sleepMs(int ms)
+{
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+void thread_pause(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+void thread_yield(void)
+{
+    sched_yield();
+}
+
+double thread_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int atomic_get(volatile int *p)
+{
+    return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+void atomic_set(volatile int *p, int value)
+{
+    __atomic_store_n(p, value, __ATOMIC_SEQ_CST);
+}
+
+int atomic_swap(volatile int *p, int value)
+{
+    return __atomic_exchange_n(p, value, __ATOMIC_SEQ_CST);
+}
+
+bool atomic_cas(volatile int *p, int expected, int desired)
+{
+    return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+int atomic_add(volatile int *p, int value)
+{
+    return __atomic_fetch_add(p, value, __ATOMIC_SEQ_CST);
+}
+
+unsigned long long atomic_get64(volatile unsigned long long *p)
+{
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+void atomic_set64(volatile unsigned long long *p, unsigned long long value)
+{
+    __atomic_store_n(p, value, __ATOMIC_RELAXED);
+}
+
+#endif
+
+int signal_count(ThreadSignal *s)
+{
+    return atomic_get(&s->count);
+}
@@ -0,0 +1,62 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+// Minimal platform layer for threads, atomics and time (Win32 or pthreads).
+// Kept in its own translation unit so windows.h never meets raylib.h.
+// Web builds without pthreads get stubs: thread_start fails and callers
+// fall back to running on the calling thread.
+
+#include <stdbool.h>
+
+typedef struct Thread
+{
+    void *handle;
+} Thread;
+
+typedef void (*ThreadFunc)(void *arg);
+
+// Lets threads sleep until another one has something for them (an event count): take
+// signal_count, look for work, and if there is none signal_wait for the count to move
+// on. A signal_notify in between is not lost, the wait returns right away then.
+typedef struct ThreadSignal
+{
+    void *handle;
+    volatile int count;
+    volatile int waiters;
+} ThreadSignal;
+
+// returns false if the thread could not be started (or threads are unavailable)
+bool thread_start(Thread *t, ThreadFunc func, void *arg);
+void thread_join(Thread *t);
+int thread_cpuCount(void);
+void thread_sleepMs(int ms);
+// for spin loops: a hint to the core, gives the rest of the time slice away
+void thread_pause(void);
+void thread_yield(void);
+
+// returns false if out of memory
+bool signal_init(ThreadSignal *s);
+void signal_free(ThreadSignal *s);
+int signal_count(ThreadSignal *s);
+// returns once the count is no longer count (right away without threads)
+void signal_wait(ThreadSignal *s, int count);
+// moves the count on and wakes all waiting threads
+void signal_notify(ThreadSignal *s);
+// monotonic time in seconds
+double thread_time(void);
+
+// sequentially consistent atomics on int
+int atomic_get(volatile int *p);
+void atomic_set(volatile int *p, int value);
+// stores value, returns the previous value
+int atomic_swap(volatile int *p, int value);
+// stores desired if *p == expected, returns true if it did
+bool atomic_cas(volatile int *p, int expected, int desired);
+// adds value, returns the previous value
+int atomic_add(volatile int *p, int value);
+// Relaxed (no ordering with other memory) atomics on 64 bit words, also whole on 32 bit
+// targets. p must be 8 byte aligned.
+unsigned long long atomic_get64(volatile unsigned long long *p);
+void atomic_set64(volatile unsigned long long *p, unsigned long long value);
+
+#endif // THREAD_H
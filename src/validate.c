@@ -0,0 +1,354 @@
+// Validation service for replays (src/replay.h): plays every replay headlessly against
+// the shipped LEVELS and prints the score it really earns, the way level() hands out
+// stars (the best attempt counts, R and "Try again" start a new one).
+// Usage: validate [--threads n] [--watch <directory>]
+// Without --watch, replay file names are read from stdin, one per line, until it is
+// closed. With --watch, the directory is checked for new *.mtdr files every
+// VALIDATE_POLL_MS, validated files are renamed to <name>.done so they are only
+// picked up once. Write files under another name and rename them when complete.
+//
+// One line per replay on stdout, in the order they finish:
+//   <file>,<level index>,<score>,<status>
+// status is "ok" or why the replay was rejected (score 0 then): malformed, not a
+// level, a command the level does not allow (same placement rules as verify), a
+// command with another result than recorded, or too many frames.
+//
+// Replays are spread over worker threads (all cores by default). Every worker owns a
+// GameState, a small HealthCache and one replay buffer of REPLAY_SIZE_DEFAULT bytes,
+// bigger files are rejected. Memory per worker is fixed, nothing is allocated per replay.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <dirent.h>
+#endif
+
+#include "sim.h"
+#include "replay.h"
+#include "thread.h"
+#include "levels.h"
+
+#define VALIDATE_QUEUE_SIZE 256 // power of two
+#define VALIDATE_PATH_MAX 512
+#define VALIDATE_POLL_MS 200
+#define VALIDATE_CACHE_BITS 12
+#define VALIDATE_MAX_FRAMES (60 * 60 * 60) // simulated per replay, an hour of game time
+
+typedef struct Validator
+{
+    // file names waiting for a worker, guarded by lock
+    char (*queue)[VALIDATE_PATH_MAX];
+    unsigned int queueHead;
+    unsigned int queueTail;
+    volatile int lock;
+    volatile int done; // no more file names coming
+
+    bool watch; // rename validated files
+    volatile int outputLock;
+    volatile int validated;
+    volatile int rejected;
+} Validator;
+
+typedef struct Worker
+{
+    Thread thread;
+    Validator *v;
+    GameState state;
+    HealthCache cache;
+    Replay replay;
+} Worker;
+
+static void lock(volatile int *l)
+{
+    while (!atomic_cas(l, 0, 1))
+        ;
+}
+
+static void unlock(volatile int *l)
+{
+    atomic_set(l, 0);
+}
+
+// returns false if the queue is full
+static bool queue_push(Validator *v, const char *path)
+{
+    lock(&v->lock);
+    bool full = (v->queueHead - v->queueTail == VALIDATE_QUEUE_SIZE);
+    if (!full)
+        snprintf(v->queue[v->queueHead++ & (VALIDATE_QUEUE_SIZE - 1)], VALIDATE_PATH_MAX, "%s", path);
+    unlock(&v->lock);
+    return !full;
+}
+
+static bool queue_pop(Validator *v, char *path)
+{
+    lock(&v->lock);
+    bool empty = (v->queueHead == v->queueTail);
+    if (!empty)
+        memcpy(path, v->queue[v->queueTail++ & (VALIDATE_QUEUE_SIZE - 1)], VALIDATE_PATH_MAX);
+    unlock(&v->lock);
+    return !empty;
+}
+
+static void queue_pushWait(Validator *v, const char *path)
+{
+    while (!queue_push(v, path))
+        thread_sleepMs(1);
+}
+
+// same rules as placing with the mouse in level(), see verify.c
+static bool isAllowed(const SimCommand *cmd, int levelIndex)
+{
+    const LevelDef *def = LEVELS + levelIndex;
+    switch (cmd->type)
+    {
+        case CMD_ADD_TOWER:
+            return sim_canPlaceTile(cmd->tileX, cmd->tileY)
+                && cmd->tower > ET_NONE && cmd->tower < ET_EOL
+                && (def->towersAllowed & (1 << cmd->tower)) != 0
+                && cmd->scale == defaultTowerScale(cmd->tower);
+        case CMD_LOAD_LEVEL: // restart
+            return cmd->levelIndex == levelIndex;
+        default:
+            return false;
+    }
+}
+
+// Returns NULL if the replay is valid, the reason otherwise. score is the best of all
+// attempts in the replay.
+static const char *validate(Worker *w, const char *path, int *levelIndex, int *score)
+{
+    GameState *s = &w->state;
+    *levelIndex = -1;
+    *score = 0;
+    if (!replay_load(&w->replay, path))
+        return "cannot read file (or too big)";
+
+    ReplayReader reader;
+    unsigned int frame;
+    if (!replay_start(&reader, &w->replay, s, &frame))
+        return "malformed";
+    *levelIndex = reader.levelIndex;
+    if (reader.levelIndex < 0)
+        return "not a level";
+
+    unsigned int simulated = 0;
+    ReplayEvent e;
+    bool more;
+    do
+    {
+        more = replay_next(&reader, &e);
+        if (reader.error)
+            return "malformed";
+
+        // nothing changes the score once an attempt is over
+        while (frame != e.frame && !state_isOver(s))
+        {
+            unsigned int frames = level_advance(s, frame, MIN(e.frame - frame, VALIDATE_MAX_FRAMES - simulated));
+            frame += frames;
+            simulated += frames;
+            if (simulated >= VALIDATE_MAX_FRAMES)
+                return "too many frames";
+        }
+        frame = e.frame;
+
+        if (!more || e.type != RE_COMMAND)
+            continue;
+        if (!isAllowed(&e.command, reader.levelIndex))
+            return "command not allowed in the level";
+        if (e.command.type == CMD_LOAD_LEVEL && state_score(s) > *score)
+            *score = state_score(s);
+        if (sim_applyCommand(s, &frame, &e.command) != e.accepted)
+            return "played out differently than recorded";
+    } while (more);
+
+    if (state_score(s) > *score)
+        *score = state_score(s);
+    return NULL;
+}
+
+static void worker(void *arg)
+{
+    Worker *w = arg;
+    Validator *v = w->v;
+    char path[VALIDATE_PATH_MAX];
+    char line[VALIDATE_PATH_MAX + 64];
+    for (;;)
+    {
+        // done is set after the last push, so an empty queue after seeing it is final
+        bool done = atomic_get(&v->done);
+        if (!queue_pop(v, path))
+        {
+            if (done)
+                break;
+            thread_sleepMs(1);
+            continue;
+        }
+
+        int levelIndex, score;
+        const char *error = validate(w, path, &levelIndex, &score);
+        if (error)
+            score = 0;
+        snprintf(line, sizeof(line), "%s,%d,%d,%s\n", path, levelIndex, score, error ? error : "ok");
+
+        if (v->watch)
+        {
+            char donePath[VALIDATE_PATH_MAX + 8];
+            snprintf(donePath, sizeof(donePath), "%s.done", path);
+            remove(donePath);
+            rename(path, donePath);
+        }
+
+        lock(&v->outputLock);
+        fputs(line, stdout);
+        unlock(&v->outputLock);
+        atomic_add(error ? &v->rejected : &v->validated, 1);
+    }
+}
+
+static bool endsWith(const char *s, const char *suffix)
+{
+    size_t len = strlen(s);
+    size_t suffixLen = strlen(suffix);
+    return len >= suffixLen && strcmp(s + len - suffixLen, suffix) == 0;
+}
+
+// queues the *.mtdr files in directory, returns the number found
+static int scanDirectory(Validator *v, const char *directory)
+{
+    int found = 0;
+    char path[VALIDATE_PATH_MAX];
+#if defined(_WIN32)
+    snprintf(path, sizeof(path), "%s\\*.mtdr", directory);
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(path, &data);
+    if (find == INVALID_HANDLE_VALUE)
+        return 0;
+    do
+    {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY || !endsWith(data.cFileName, ".mtdr"))
+            continue;
+        snprintf(path, sizeof(path), "%s\\%s", directory, data.cFileName);
+        queue_pushWait(v, path);
+        ++found;
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    DIR *dir = opendir(directory);
+    if (dir == NULL)
+        return 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (!endsWith(entry->d_name, ".mtdr"))
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        queue_pushWait(v, path);
+        ++found;
+    }
+    closedir(dir);
+#endif
+    return found;
+}
+
+// waits until the workers took and finished everything queued so far
+static void waitIdle(Validator *v, int queued)
+{
+    while (atomic_get(&v->validated) + atomic_get(&v->rejected) < queued)
+        thread_sleepMs(1);
+}
+
+int main(int argc, char **argv)
+{
+    int threadCount = thread_cpuCount();
+    const char *watch = NULL;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threadCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc)
+            watch = argv[++i];
+        else
+        {
+            printf("Usage: validate [--threads n] [--watch <directory>]\n");
+            return 1;
+        }
+    }
+    if (threadCount < 1)
+        threadCount = 1;
+
+    Validator v = { .watch = watch != NULL };
+    v.queue = calloc(VALIDATE_QUEUE_SIZE, sizeof(v.queue[0]));
+    Worker *workers = calloc(threadCount, sizeof(Worker));
+    for (int i = 0; i < threadCount; ++i)
+    {
+        Worker *w = workers + i;
+        w->v = &v;
+        state_init(&w->state);
+        cache_init(&w->cache, VALIDATE_CACHE_BITS);
+        w->state.healthCache = &w->cache;
+        replay_init(&w->replay, REPLAY_SIZE_DEFAULT);
+    }
+
+    // the calling thread reads input, workers that failed to start are covered by the others
+    int started = 0;
+    for (int i = 0; i < threadCount; ++i)
+        started += thread_start(&workers[i].thread, worker, workers + i);
+    if (started == 0)
+    {
+        fprintf(stderr, "ERROR: Could not start worker threads\n");
+        return 1;
+    }
+
+    double start = thread_time();
+    int queued = 0;
+    if (watch)
+    {
+        fprintf(stderr, "validate: watching %s for *.mtdr files\n", watch);
+        for (;;)
+        {
+            int found = scanDirectory(&v, watch);
+            queued += found;
+            // the files are renamed when done, wait so the next scan does not see them again
+            waitIdle(&v, queued);
+            fflush(stdout);
+            if (found == 0)
+                thread_sleepMs(VALIDATE_POLL_MS);
+        }
+    }
+
+    char line[VALIDATE_PATH_MAX];
+    while (fgets(line, sizeof(line), stdin))
+    {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == 0)
+            continue;
+        queue_pushWait(&v, line);
+        ++queued;
+    }
+    atomic_set(&v.done, 1);
+    for (int i = 0; i < threadCount; ++i)
+    {
+        if (workers[i].thread.handle)
+            thread_join(&workers[i].thread);
+    }
+    double seconds = thread_time() - start;
+    fflush(stdout);
+    fprintf(stderr, "validate: %d replay(s), %d rejected, %.2fs on %d thread(s), %.0f replays/s\n",
+        queued, v.rejected, seconds, started, queued / (seconds > 0 ? seconds : 1e-9));
+
+    for (int i = 0; i < threadCount; ++i)
+    {
+        state_free(&workers[i].state);
+        cache_free(&workers[i].cache);
+        replay_free(&workers[i].replay);
+    }
+    free(workers);
+    free(v.queue);
+    return v.rejected > 0 ? 1 : 0;
+}
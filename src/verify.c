@@ -0,0 +1,226 @@
+// Plays tower placements for the shipped levels headlessly, one placement per thread.
+// Usage: verify <placement file> [thread count], exits with 1 if a placement is invalid
+// or does not get its expected score.
+//
+// Placement file, '#' starts a comment:
+//   level <index> [expected score]
+//   <tile x> <tile y> <type> [scale]
+// Every level line starts a new placement, the tower lines below it are placed in
+// order. Types are the EQUATION_NAMES (e.g. sub, sqrt, log_10), scale defaults to
+// defaultTowerScale.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+#include "thread.h"
+#include "levels.h"
+
+#define PLACEMENTS_MAX 256
+#define VERIFY_MAX_FRAMES (60 * 60 * 60) // an hour of game time
+
+typedef struct Placement
+{
+    int line; // in the placement file
+    int levelIndex;
+    int expectedScore; // -1: any
+    int towerLen;
+    SimCommand towers[MAX_TOWERS];
+
+    // result
+    char error[128];
+    bool won;
+    int health;
+    int score;
+    unsigned int frames;
+} Placement;
+
+typedef struct Verify
+{
+    Placement *placements;
+    int placementLen;
+    volatile int next;
+} Verify;
+
+static bool readPlacements(Verify *v, FILE *f, const char *filename)
+{
+    char line[256];
+    int lineNumber = 0;
+    Placement *p = NULL;
+    while (fgets(line, sizeof(line), f))
+    {
+        ++lineNumber;
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+
+        char word[32] = "";
+        int a = 0, b = 0, scale = 0;
+        int read = sscanf(line, "%31s", word);
+        if (read <= 0)
+            continue;
+
+        if (strcmp(word, "level") == 0)
+        {
+            if (v->placementLen >= PLACEMENTS_MAX)
+            {
+                printf("ERROR: %s:%d: more than %d placements\n", filename, lineNumber, PLACEMENTS_MAX);
+                return false;
+            }
+            read = sscanf(line, "%*s %d %d", &a, &b);
+            if (read < 1 || a < 0 || a >= (int)ARRAY_SIZE(LEVELS))
+            {
+                printf("ERROR: %s:%d: expected level <index 0-%d> [score]\n", filename, lineNumber, (int)ARRAY_SIZE(LEVELS) - 1);
+                return false;
+            }
+            p = v->placements + v->placementLen++;
+            *p = (Placement){ .line = lineNumber, .levelIndex = a, .expectedScore = read > 1 ? b : -1 };
+            continue;
+        }
+
+        read = sscanf(line, "%d %d %31s %d", &a, &b, word, &scale);
+        int type = ET_NONE;
+        for (int i = ET_NONE + 1; i < ET_EOL && read >= 3; ++i)
+        {
+            if (strcmp(word, EQUATION_NAMES[i]) == 0)
+                type = i;
+        }
+        if (read < 3 || type == ET_NONE)
+        {
+            printf("ERROR: %s:%d: expected <tile x> <tile y> <type> [scale]\n", filename, lineNumber);
+            return false;
+        }
+        if (p == NULL)
+        {
+            printf("ERROR: %s:%d: tower before the first level line\n", filename, lineNumber);
+            return false;
+        }
+        if (p->towerLen >= MAX_TOWERS)
+        {
+            printf("ERROR: %s:%d: more than %d towers\n", filename, lineNumber, MAX_TOWERS);
+            return false;
+        }
+        p->towers[p->towerLen++] = (SimCommand){
+            .type = CMD_ADD_TOWER,
+            .tileX = a,
+            .tileY = b,
+            .tower = type,
+            .scale = read > 3 ? scale : defaultTowerScale(type),
+        };
+    }
+    return true;
+}
+
+static void play(GameState *s, Placement *p)
+{
+    const LevelDef *def = LEVELS + p->levelIndex;
+    state_reset(s);
+    state_loadFromLevelDef(s, *def, p->levelIndex);
+
+    unsigned int frame = 0;
+    for (int i = 0; i < p->towerLen; ++i)
+    {
+        const SimCommand *cmd = p->towers + i;
+        // same rules as placing with the mouse in level()
+        bool valid = sim_canPlaceTile(cmd->tileX, cmd->tileY)
+            && (def->towersAllowed & (1 << cmd->tower)) != 0;
+        if (!valid || !sim_applyCommand(s, &frame, cmd))
+        {
+            snprintf(p->error, sizeof(p->error), "tower %d (%d, %d, %s) cannot be placed",
+                i + 1, cmd->tileX, cmd->tileY, EQUATION_NAMES[cmd->tower]);
+            return;
+        }
+    }
+
+    while (!state_isOver(s) && frame < VERIFY_MAX_FRAMES)
+        frame += level_advance(s, frame, VERIFY_MAX_FRAMES - frame);
+    if (!state_isOver(s))
+        snprintf(p->error, sizeof(p->error), "not over after %u frames", frame);
+
+    p->score = state_score(s);
+    p->won = p->score > 0;
+    p->health = s->home.health;
+    p->frames = frame;
+}
+
+static void worker(void *arg)
+{
+    Verify *v = arg;
+    GameState state;
+    state_init(&state);
+    HealthCache cache;
+    cache_init(&cache, HEALTH_CACHE_BITS_DEFAULT);
+    state.healthCache = &cache;
+
+    int i;
+    while ((i = atomic_add(&v->next, 1)) < v->placementLen)
+        play(&state, v->placements + i);
+
+    state_free(&state);
+    cache_free(&cache);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: verify <placement file> [thread count]\n");
+        return 1;
+    }
+    FILE *f = fopen(argv[1], "r");
+    if (f == NULL)
+    {
+        printf("ERROR: Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    Verify v = { .placements = calloc(PLACEMENTS_MAX, sizeof(Placement)) };
+    bool ok = readPlacements(&v, f, argv[1]);
+    fclose(f);
+    if (!ok)
+    {
+        free(v.placements);
+        return 1;
+    }
+
+    int threadCount = argc > 2 ? atoi(argv[2]) : thread_cpuCount();
+    threadCount = MIN(threadCount, v.placementLen);
+    if (threadCount < 1)
+        threadCount = 1;
+    Thread *threads = calloc(threadCount, sizeof(Thread));
+    double start = thread_time();
+    // the calling thread works too, it also covers threads that failed to start
+    for (int i = 1; i < threadCount; ++i)
+        thread_start(threads + i, worker, &v);
+    worker(&v);
+    for (int i = 1; i < threadCount; ++i)
+        thread_join(threads + i);
+    double seconds = thread_time() - start;
+
+    int failed = 0;
+    for (int i = 0; i < v.placementLen; ++i)
+    {
+        const Placement *p = v.placements + i;
+        bool unexpected = p->expectedScore >= 0 && p->score != p->expectedScore;
+        const char *status = "ok";
+        if (p->error[0])
+            status = p->error;
+        else if (unexpected)
+            status = "FAILED (expected score differs)";
+        if (p->error[0] || unexpected)
+            ++failed;
+
+        char expected[16] = "-";
+        if (p->expectedScore >= 0)
+            snprintf(expected, sizeof(expected), "%d", p->expectedScore);
+        printf("%2d %-24s line %3d  %-4s  health %2d  score %d/3 (expected %s)  towers %2d  frames %6u  %s\n",
+            p->levelIndex, LEVELS[p->levelIndex].name, p->line, p->won ? "win" : "lose",
+            p->health, p->score, expected, p->towerLen, p->frames, status);
+    }
+    printf("%d placement(s), %d failed, %.2fs on %d thread(s)\n", v.placementLen, failed, seconds, threadCount);
+
+    free(threads);
+    free(v.placements);
+    return failed > 0 ? 1 : 0;
+}